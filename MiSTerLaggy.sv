@@ -182,22 +182,22 @@ module emu
 
 ///////// Default values for ports not used in this core /////////
 
-assign ADC_BUS  = 'Z;
 assign {UART_RTS, UART_TXD, UART_DTR} = 0;
 assign {SD_SCK, SD_MOSI, SD_CS} = 'Z;
 assign {SDRAM_DQ, SDRAM_A, SDRAM_BA, SDRAM_CLK, SDRAM_CKE, SDRAM_DQML, SDRAM_DQMH, SDRAM_nWE, SDRAM_nCAS, SDRAM_nRAS, SDRAM_nCS} = 'Z;
 assign {DDRAM_CLK, DDRAM_BURSTCNT, DDRAM_ADDR, DDRAM_DIN, DDRAM_BE, DDRAM_RD, DDRAM_WE} = '0;  
 
 assign VGA_SL = 0;
-assign VGA_F1 = 0;
 assign VGA_SCALER  = 0;
 assign VGA_DISABLE = 0;
 assign HDMI_FREEZE = 0;
 assign HDMI_BLACKOUT = 0;
 
-assign AUDIO_S = 0;
-assign AUDIO_L = 0;
-assign AUDIO_R = 0;
+wire [15:0] audio;
+
+assign AUDIO_S = 1;
+assign AUDIO_L = audio;
+assign AUDIO_R = audio;
 assign AUDIO_MIX = 0;
 
 assign LED_DISK = 0;
@@ -324,10 +324,26 @@ end
 
 wire reset = RESET | status[0] | buttons[1] | ioctl_download;
 
+// Analog sensor input, a single channel at the maximum conversion rate
+wire [11:0] adc_sample;
+wire adc_sync;
+
+ltc2308 #(.NUM_CH(1), .ADC_RATE(500000), .CLK_RATE(50000000)) adc
+(
+	.reset(reset),
+	.clk(CLK_50M),
+
+	.ADC_BUS(ADC_BUS),
+
+	.dout_sync(adc_sync),
+	.dout(adc_sample)
+);
+
 wire HBlank;
 wire HSync;
 wire VBlank;
 wire VSync;
+wire Field;
 
 system system
 (
@@ -342,11 +358,14 @@ system system
 	.HSync(HSync),
 	.VBlank(VBlank),
 	.VSync(VSync),
+	.Field(Field),
 
 	.r(VGA_R),
 	.g(VGA_G),
 	.b(VGA_B),
 
+	.audio(audio),
+
 	.gamepad(gamepad[15:0]),
 	.user_out(USER_OUT),
 	.user_in(USER_IN),
@@ -365,6 +384,9 @@ system system
 
 	.hdmi_vblank(HDMI_VBL),
 
+	.adc_sample(adc_sample),
+	.adc_sync(adc_sync),
+
 	.new_vmode(new_vmode),
 	.arx(VIDEO_ARX),
 	.ary(VIDEO_ARY),
@@ -380,6 +402,7 @@ assign CLK_VIDEO = clk_sys;
 assign VGA_DE = ~(HBlank | VBlank);
 assign VGA_HS = HSync;
 assign VGA_VS = VSync;
+assign VGA_F1 = Field;
 
 reg  [26:0] act_cnt;
 always @(posedge clk_sys) act_cnt <= act_cnt + 1'd1; 
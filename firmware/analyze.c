@@ -0,0 +1,77 @@
+// Host tool that runs the analog step response analysis over a recorded
+// sample file, so the analysis can be checked against scope captures or
+// synthetic steps without the hardware. The file has one sample per line,
+// a "# sample_us N" line sets the sample interval (default 2us), a "# pre N"
+// line gives the number of samples from before the stimulus (default 0) and
+// other lines starting with '#' are ignored.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "response.h"
+
+#define MAX_SAMPLES 65535
+
+static uint16_t samples[MAX_SAMPLES];
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <SAMPLES.TXT>\n", argv[0]);
+        return -1;
+    }
+
+    FILE *fp = fopen(argv[1], "rt");
+    if (fp == NULL)
+    {
+        perror(argv[1]);
+        return -1;
+    }
+
+    char line[128];
+    double sample_us = 2.0;
+    unsigned pre = 0;
+    uint16_t count = 0;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#')
+        {
+            sscanf(line, "# sample_us %lf", &sample_us);
+            sscanf(line, "# pre %u", &pre);
+            continue;
+        }
+
+        char *end;
+        long v = strtol(line, &end, 0);
+        if (end == line) continue;
+
+        if (count == MAX_SAMPLES)
+        {
+            fprintf(stderr, "Too many samples, only using the first %u\n", MAX_SAMPLES);
+            break;
+        }
+        samples[count++] = v < 0 ? 0 : v > 0xffff ? 0xffff : v;
+    }
+
+    fclose(fp);
+
+    StepResponse r;
+    if (!response_analyze(samples, count, pre, &r))
+    {
+        printf("No step found in %u samples\n", count);
+        return 1;
+    }
+
+    double scale = sample_us / (1 << RESPONSE_FRAC_BITS);
+
+    printf("%s %u -> %u\n", r.rising ? "Rise" : "Fall", r.start_level, r.end_level);
+    printf("10%%: %.1f us\n", r.t10 * scale);
+    printf("90%%: %.1f us\n", r.t90 * scale);
+    printf("Response: %.1f us\n", response_time(&r) * scale);
+    printf("Overshoot: %u.%u%%\n", r.overshoot_permille / 10, r.overshoot_permille % 10);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Host tool that replays a file of edges through the audio to video sync
+// analysis, so it can be checked against synthetic or logic analyzer edges
+// without the hardware. Each line is one event, with times in 10MHz ticks:
+//   begin T          a sample starts, earlier edges are ignored
+//   video T          rising edge from the light sensor
+//   audio T          rising edge from the audio detector
+//   end COMMIT CLICK the sample ends, with the frame commit and click stamps
+//   abort            the sample ends without the patch or click going out
+// Lines starting with '#' are ignored.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avsync.h"
+
+#define TICKS_PER_MS 10000.0
+
+static void print_stat(const char *name, const AvSyncStat *s)
+{
+    if (s->count == 0)
+    {
+        printf("%s: -\n", name);
+        return;
+    }
+
+    printf("%s: avg %.3f min %.3f max %.3f ms (%u)\n", name,
+            avsync_mean(s) / TICKS_PER_MS, s->min_ticks / TICKS_PER_MS, s->max_ticks / TICKS_PER_MS, s->count);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <EDGES.TXT>\n", argv[0]);
+        return -1;
+    }
+
+    FILE *fp = fopen(argv[1], "rt");
+    if (fp == NULL)
+    {
+        perror(argv[1]);
+        return -1;
+    }
+
+    avsync_reset();
+
+    char line[128];
+    int line_num = 0;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        line_num++;
+        if (line[0] == '#') continue;
+
+        char cmd[16];
+        unsigned long a, b;
+        int n = sscanf(line, "%15s %lu %lu", cmd, &a, &b);
+        if (n <= 0) continue;
+
+        if (!strcmp(cmd, "begin") && n == 2)
+            avsync_begin(a);
+        else if (!strcmp(cmd, "video") && n == 2)
+            avsync_video_edge(a);
+        else if (!strcmp(cmd, "audio") && n == 2)
+            avsync_audio_edge(a);
+        else if (!strcmp(cmd, "end") && n == 3)
+            avsync_end(a, b);
+        else if (!strcmp(cmd, "abort"))
+            avsync_abort();
+        else
+            fprintf(stderr, "Line %d not understood: %s", line_num, line);
+    }
+
+    fclose(fp);
+
+    const AvSyncStats *s = avsync_stats();
+    printf("Samples: %u, no video: %u, no audio: %u\n", s->samples, s->no_video, s->no_audio);
+    print_stat("Video", &s->video);
+    print_stat("Audio", &s->audio);
+    print_stat("Offset", &s->offset);
+
+    return 0;
+}
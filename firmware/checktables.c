@@ -0,0 +1,75 @@
+// Host check of the generated mode tables. Every entry genmodes wrote into
+// modetable.c is recomputed with the float reference in modecalc_float.c, the
+// original CVT and PLL code, and the timings and PLL words must match exactly.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "modecalc_float.h"
+#include "modes.h"
+
+static int entries = 0;
+static int failures = 0;
+
+static void check(const ModeTiming *table, const ModeTiming *expect, const char *name, uint32_t millihz)
+{
+    const VideoMode *a = &table->mode;
+    const VideoMode *b = &expect->mode;
+
+    entries++;
+    if (a->hact != b->hact || a->hfp != b->hfp || a->hs != b->hs || a->hbp != b->hbp
+        || a->vact != b->vact || a->vfp != b->vfp || a->vs != b->vs || a->vbp != b->vbp
+        || a->khz != b->khz || memcmp(&table->pll, &expect->pll, sizeof(PLLConfig)) != 0)
+    {
+        printf("%s @ %u.%03uhz differs\n", name, millihz / 1000, millihz % 1000);
+        printf("  table %u %u %u %u %u %u %u %u %ukhz m %08x c %08x k %08x\n",
+                a->hact, a->hfp, a->hs, a->hbp, a->vact, a->vfp, a->vs, a->vbp, a->khz,
+                table->pll.m, table->pll.c, table->pll.k);
+        printf("  float %u %u %u %u %u %u %u %u %ukhz m %08x c %08x k %08x\n",
+                b->hact, b->hfp, b->hs, b->hbp, b->vact, b->vfp, b->vs, b->vbp, b->khz,
+                expect->pll.m, expect->pll.c, expect->pll.k);
+        failures++;
+    }
+}
+
+int main()
+{
+    ModeTiming timing;
+    char name[32];
+
+    for( int r = 0; r < NUM_HDMI_RESOLUTIONS; r++ )
+    {
+        const HDMIResolution *res = &hdmi_resolutions[r];
+        snprintf(name, sizeof(name), "%ux%u", res->width, res->height);
+        for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+        {
+            float_hdmi_calc_mode(res->width, res->height, hdmi_refresh_rates[i], &timing);
+            check(&hdmi_mode_table[r][i], &timing, name, hdmi_refresh_rates[i]);
+        }
+    }
+
+    for( int wide = 0; wide < 2; wide++ )
+    {
+        for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+        {
+            uint32_t millihz = modes_core_refresh(hdmi_refresh_rates[i]);
+            float_core_calc_mode(millihz, wide, &timing);
+            check(&core_mode_table[wide][i], &timing, wide ? "16:9 240p" : "4:3 240p", millihz);
+        }
+    }
+
+    for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+    {
+        uint32_t millihz = modes_native_refresh(hdmi_refresh_rates[i]);
+        float_core_calc_native_mode(millihz, &timing);
+        check(&core_native_table[i], &timing, "native", millihz);
+    }
+
+    float_core_calc_interlaced_mode(CORE_480I_MILLIHZ, false, &timing);
+    check(&core_interlaced_table[0], &timing, "480i", CORE_480I_MILLIHZ);
+    float_core_calc_interlaced_mode(CORE_576I_MILLIHZ, true, &timing);
+    check(&core_interlaced_table[1], &timing, "576i", CORE_576I_MILLIHZ);
+
+    printf("%d table entries checked, %d differ\n", entries, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+// Host harness that compares the integer CVT and PLL code in modecalc.c with
+// the float reference in modecalc_float.c across the supported range. Every
+// HDMI resolution and core timing is calculated at each refresh rate from
+// 23Hz to 241Hz, in steps of 1mHz unless another step is given, and every
+// timing and PLL word must be identical.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modecalc.h"
+#include "modecalc_float.h"
+#include "modes.h"
+
+#define MIN_MILLIHZ 23000
+#define MAX_MILLIHZ 241000
+#define MAX_REPORTS 20
+
+static unsigned long cases = 0;
+static unsigned long failures = 0;
+
+static bool same_timing(const ModeTiming *a, const ModeTiming *b)
+{
+    const VideoMode *ma = &a->mode;
+    const VideoMode *mb = &b->mode;
+
+    return ma->hact == mb->hact && ma->hfp == mb->hfp && ma->hs == mb->hs && ma->hbp == mb->hbp
+        && ma->vact == mb->vact && ma->vfp == mb->vfp && ma->vs == mb->vs && ma->vbp == mb->vbp
+        && ma->khz == mb->khz && memcmp(&a->pll, &b->pll, sizeof(PLLConfig)) == 0;
+}
+
+static void compare(const ModeTiming *integer, const ModeTiming *reference, const char *name, uint32_t millihz)
+{
+    cases++;
+    if (same_timing(integer, reference)) return;
+
+    failures++;
+    if (failures > MAX_REPORTS) return;
+
+    printf("%s @ %u.%03uhz differs: m %08x c %08x k %08x, float m %08x c %08x k %08x\n",
+            name, millihz / 1000, millihz % 1000,
+            integer->pll.m, integer->pll.c, integer->pll.k,
+            reference->pll.m, reference->pll.c, reference->pll.k);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t step = 1;
+
+    if (argc > 2 || (argc == 2 && (step = strtoul(argv[1], NULL, 0)) == 0))
+    {
+        fprintf(stderr, "Usage: %s [STEP_MILLIHZ]\n", argv[0]);
+        return -1;
+    }
+
+    ModeTiming integer, reference;
+    char name[32];
+
+    for( uint32_t millihz = MIN_MILLIHZ; millihz <= MAX_MILLIHZ; millihz += step )
+    {
+        for( int r = 0; r < NUM_HDMI_RESOLUTIONS; r++ )
+        {
+            const HDMIResolution *res = &hdmi_resolutions[r];
+            snprintf(name, sizeof(name), "%ux%u", res->width, res->height);
+
+            bool ok = hdmi_calc_mode(res->width, res->height, millihz, &integer);
+            bool ref_ok = float_hdmi_calc_mode(res->width, res->height, millihz, &reference);
+            if (ok != ref_ok) memset(&reference, 0xff, sizeof(reference));
+            compare(&integer, &reference, name, millihz);
+        }
+
+        for( int wide = 0; wide < 2; wide++ )
+        {
+            core_calc_mode(millihz, wide, &integer);
+            float_core_calc_mode(millihz, wide, &reference);
+            compare(&integer, &reference, wide ? "16:9 240p" : "4:3 240p", millihz);
+        }
+
+        core_calc_native_mode(millihz, &integer);
+        float_core_calc_native_mode(millihz, &reference);
+        compare(&integer, &reference, "native", millihz);
+
+        for( int pal = 0; pal < 2; pal++ )
+        {
+            core_calc_interlaced_mode(millihz, pal, &integer);
+            float_core_calc_interlaced_mode(millihz, pal, &reference);
+            compare(&integer, &reference, pal ? "576i" : "480i", millihz);
+        }
+    }
+
+    printf("%lu cases compared, %lu differ\n", cases, failures);
+    return failures ? 1 : 0;
+}
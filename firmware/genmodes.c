@@ -0,0 +1,92 @@
+// Host tool that precomputes the video mode tables so that switching modes
+// on the 68000 is a table lookup instead of a soft-float CVT and PLL solve.
+// It runs the same modecalc.c code the firmware uses for custom modes.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "modecalc.h"
+#include "modes.h"
+
+static void write_timing(FILE *fp, const ModeTiming *t, const char *comment)
+{
+    const VideoMode *m = &t->mode;
+
+    fprintf(fp, "    { { %u, %u, %u, %u, %u, %u, %u, %u, %u }, { 0x%08x, 0x%08x, 0x%08x } }, // %s\n",
+            m->hact, m->hfp, m->hs, m->hbp, m->vact, m->vfp, m->vs, m->vbp, m->khz,
+            t->pll.m, t->pll.c, t->pll.k, comment);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <OUTPUT.C>\n", argv[0]);
+        return -1;
+    }
+
+    FILE *fp = fopen(argv[1], "wt");
+    if (fp == NULL)
+    {
+        perror(argv[1]);
+        return -1;
+    }
+
+    char comment[64];
+    ModeTiming timing;
+
+    fprintf(fp, "// Generated by genmodes, do not edit\n\n#include \"modes.h\"\n\n");
+
+    fprintf(fp, "const ModeTiming hdmi_mode_table[NUM_HDMI_RESOLUTIONS][NUM_HDMI_REFRESH_RATES] =\n{\n");
+    for( int r = 0; r < NUM_HDMI_RESOLUTIONS; r++ )
+    {
+        const HDMIResolution *res = &hdmi_resolutions[r];
+        fprintf(fp, "  {\n");
+        for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+        {
+            uint32_t millihz = hdmi_refresh_rates[i];
+            if (hdmi_calc_mode(res->width, res->height, millihz, &timing))
+                snprintf(comment, sizeof(comment), "%ux%u @ %u.%03uhz", res->width, res->height, millihz / 1000, millihz % 1000);
+            else
+                snprintf(comment, sizeof(comment), "%ux%u @ %u.%03uhz unavailable", res->width, res->height, millihz / 1000, millihz % 1000);
+            write_timing(fp, &timing, comment);
+        }
+        fprintf(fp, "  },\n");
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "const ModeTiming core_mode_table[2][NUM_HDMI_REFRESH_RATES] =\n{\n");
+    for( int wide = 0; wide < 2; wide++ )
+    {
+        fprintf(fp, "  {\n");
+        for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+        {
+            uint32_t millihz = modes_core_refresh(hdmi_refresh_rates[i]);
+            core_calc_mode(millihz, wide, &timing);
+            snprintf(comment, sizeof(comment), "%s 240p @ %u.%03uhz", wide ? "16:9" : "4:3", millihz / 1000, millihz % 1000);
+            write_timing(fp, &timing, comment);
+        }
+        fprintf(fp, "  },\n");
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "const ModeTiming core_native_table[NUM_HDMI_REFRESH_RATES] =\n{\n");
+    for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+    {
+        uint32_t millihz = modes_native_refresh(hdmi_refresh_rates[i]);
+        core_calc_native_mode(millihz, &timing);
+        snprintf(comment, sizeof(comment), "native %ux%u @ %u.%03uhz", core_native_mode.hact, core_native_mode.vact, millihz / 1000, millihz % 1000);
+        write_timing(fp, &timing, comment);
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "const ModeTiming core_interlaced_table[2] =\n{\n");
+    core_calc_interlaced_mode(CORE_480I_MILLIHZ, false, &timing);
+    write_timing(fp, &timing, "480i");
+    core_calc_interlaced_mode(CORE_576I_MILLIHZ, true, &timing);
+    write_timing(fp, &timing, "576i");
+    fprintf(fp, "};\n");
+
+    fclose(fp);
+    return 0;
+}
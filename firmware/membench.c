@@ -0,0 +1,365 @@
+// Host tool that counts 68000 cycles for each mem.c kernel against the plain
+// loops it replaced. It loads a 68000 image of mem.c and membench_ref.c and
+// calls each function under the Musashi emulator, one instruction at a time,
+// summing the cycles from entry to the return. Results are checked against the
+// expected memory contents, including guard bytes either side. Exits with an
+// error if any result is wrong or a kernel is slower than its loop for 16
+// bytes or more, so it can catch regressions. Copies between an odd and an
+// even address can only be done a byte at a time, so those are not checked
+// for speed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+
+#include "m68k.h"
+
+#define MEM_SIZE 0x100000
+#define RETURN_ADDR 0x000800 // holds a nop, the benchmark stops when the pc gets here
+#define STACK_TOP 0x0ff000
+#define DST_ADDR 0x040000
+#define SRC_ADDR 0x060000
+#define GUARD 16
+#define MAX_CYCLES 10000000
+
+static uint8_t mem[MEM_SIZE];
+static uint8_t expect[MEM_SIZE];
+
+static uint32_t get_be(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < bytes; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_be(uint8_t *p, int bytes, uint32_t v)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        p[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+static uint8_t *mem_at(unsigned int address, int bytes)
+{
+    address &= 0xffffff;
+    if (address + bytes > MEM_SIZE)
+    {
+        fprintf(stderr, "Access outside memory at %06x\n", address);
+        exit(1);
+    }
+    return &mem[address];
+}
+
+unsigned int m68k_read_memory_8(unsigned int address) { return *mem_at(address, 1); }
+unsigned int m68k_read_memory_16(unsigned int address) { return get_be(mem_at(address, 2), 2); }
+unsigned int m68k_read_memory_32(unsigned int address) { return get_be(mem_at(address, 4), 4); }
+void m68k_write_memory_8(unsigned int address, unsigned int value) { *mem_at(address, 1) = value; }
+void m68k_write_memory_16(unsigned int address, unsigned int value) { put_be(mem_at(address, 2), 2, value); }
+void m68k_write_memory_32(unsigned int address, unsigned int value) { put_be(mem_at(address, 4), 4, value); }
+
+// Loads the segments of a big endian ELF32 image and finds its symbols
+static uint8_t *elf_data;
+static long elf_size;
+
+static bool load_elf(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    elf_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    elf_data = malloc(elf_size);
+    bool ok = fread(elf_data, 1, elf_size, fp) == (size_t)elf_size;
+    fclose(fp);
+
+    if (!ok || elf_size < (long)sizeof(Elf32_Ehdr) || memcmp(elf_data, ELFMAG, SELFMAG) != 0
+        || elf_data[EI_CLASS] != ELFCLASS32 || elf_data[EI_DATA] != ELFDATA2MSB)
+    {
+        fprintf(stderr, "%s: not a big endian ELF32 file\n", path);
+        return false;
+    }
+
+    uint32_t phoff = get_be(elf_data + offsetof(Elf32_Ehdr, e_phoff), 4);
+    uint16_t phentsize = get_be(elf_data + offsetof(Elf32_Ehdr, e_phentsize), 2);
+    uint16_t phnum = get_be(elf_data + offsetof(Elf32_Ehdr, e_phnum), 2);
+
+    for (int i = 0; i < phnum; i++)
+    {
+        const uint8_t *ph = elf_data + phoff + (i * phentsize);
+        if (get_be(ph + offsetof(Elf32_Phdr, p_type), 4) != PT_LOAD) continue;
+
+        uint32_t offset = get_be(ph + offsetof(Elf32_Phdr, p_offset), 4);
+        uint32_t addr = get_be(ph + offsetof(Elf32_Phdr, p_paddr), 4);
+        uint32_t filesz = get_be(ph + offsetof(Elf32_Phdr, p_filesz), 4);
+        uint32_t memsz = get_be(ph + offsetof(Elf32_Phdr, p_memsz), 4);
+
+        if (addr + memsz > DST_ADDR || offset + filesz > (uint32_t)elf_size)
+        {
+            fprintf(stderr, "%s: segment at %06x does not fit below the buffers\n", path, addr);
+            return false;
+        }
+
+        memcpy(&mem[addr], elf_data + offset, filesz);
+        memset(&mem[addr + filesz], 0, memsz - filesz);
+    }
+
+    return true;
+}
+
+static uint32_t elf_symbol(const char *name)
+{
+    uint32_t shoff = get_be(elf_data + offsetof(Elf32_Ehdr, e_shoff), 4);
+    uint16_t shentsize = get_be(elf_data + offsetof(Elf32_Ehdr, e_shentsize), 2);
+    uint16_t shnum = get_be(elf_data + offsetof(Elf32_Ehdr, e_shnum), 2);
+
+    for (int i = 0; i < shnum; i++)
+    {
+        const uint8_t *sh = elf_data + shoff + (i * shentsize);
+        if (get_be(sh + offsetof(Elf32_Shdr, sh_type), 4) != SHT_SYMTAB) continue;
+
+        uint32_t offset = get_be(sh + offsetof(Elf32_Shdr, sh_offset), 4);
+        uint32_t size = get_be(sh + offsetof(Elf32_Shdr, sh_size), 4);
+        uint32_t link = get_be(sh + offsetof(Elf32_Shdr, sh_link), 4);
+        const uint8_t *strsh = elf_data + shoff + (link * shentsize);
+        const char *strtab = (const char *)elf_data + get_be(strsh + offsetof(Elf32_Shdr, sh_offset), 4);
+
+        for (uint32_t s = 0; s + sizeof(Elf32_Sym) <= size; s += sizeof(Elf32_Sym))
+        {
+            const uint8_t *sym = elf_data + offset + s;
+            if (strcmp(strtab + get_be(sym + offsetof(Elf32_Sym, st_name), 4), name) == 0)
+            {
+                return get_be(sym + offsetof(Elf32_Sym, st_value), 4);
+            }
+        }
+    }
+
+    fprintf(stderr, "Symbol %s not found\n", name);
+    exit(1);
+}
+
+// Calls fn with up to three long arguments and returns the cycles it took,
+// including its rts. The return value is left in d0.
+static uint32_t call(uint32_t fn, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    uint32_t sp = STACK_TOP - 16;
+    put_be(&mem[sp], 4, RETURN_ADDR);
+    put_be(&mem[sp + 4], 4, a0);
+    put_be(&mem[sp + 8], 4, a1);
+    put_be(&mem[sp + 12], 4, a2);
+
+    m68k_set_reg(M68K_REG_SP, sp);
+    m68k_set_reg(M68K_REG_PC, fn);
+
+    uint32_t cycles = 0;
+    while (m68k_get_reg(NULL, M68K_REG_PC) != RETURN_ADDR)
+    {
+        cycles += m68k_execute(1);
+        if (cycles > MAX_CYCLES)
+        {
+            fprintf(stderr, "Function at %06x did not return\n", fn);
+            exit(1);
+        }
+    }
+
+    return cycles;
+}
+
+static int failures = 0;
+
+// Fills both buffers and their guards with a pattern, which the expected
+// image starts from too
+static void prepare()
+{
+    for (int i = 0; i < 0x20000 + GUARD; i++)
+    {
+        mem[DST_ADDR - GUARD + i] = (i * 7) + 3;
+        mem[SRC_ADDR - GUARD + i] = (i * 13) + 1;
+    }
+    memcpy(expect, mem, MEM_SIZE);
+}
+
+static bool verify(const char *name, uint32_t size)
+{
+    if (memcmp(&mem[DST_ADDR - GUARD], &expect[DST_ADDR - GUARD], size + (GUARD * 2) + 4) != 0)
+    {
+        printf("%s wrote the wrong data\n", name);
+        failures++;
+        return false;
+    }
+    return true;
+}
+
+static void report(const char *kernel, uint32_t size, const char *align, bool check_speed, uint32_t ref, uint32_t opt)
+{
+    printf("%-8s %6u %-6s %9u %9u %6.2fx\n", kernel, size, align, ref, opt, (double)ref / opt);
+
+    if (check_speed && opt > ref && size >= 16)
+    {
+        printf("%s is slower than the loop it replaced\n", kernel);
+        failures++;
+    }
+}
+
+static const uint32_t sizes[] = { 4, 16, 64, 256, 1024, 4096 };
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+typedef struct
+{
+    const char *name;
+    uint32_t dst_offset;
+    uint32_t src_offset;
+    bool check_speed;
+} Alignment;
+
+static const Alignment copy_aligns[] = { { "even", 0, 0, true }, { "odd", 1, 1, true }, { "mixed", 0, 1, false } };
+static const Alignment word_aligns[] = { { "long", 0, 0, true }, { "word", 2, 2, true } };
+
+static void bench_memcpy(uint32_t fn, uint32_t ref_fn)
+{
+    for (int a = 0; a < 3; a++)
+    {
+        const Alignment *al = &copy_aligns[a];
+        for (unsigned s = 0; s < NUM_SIZES; s++)
+        {
+            uint32_t cycles[2];
+            for (int k = 0; k < 2; k++)
+            {
+                prepare();
+                memcpy(&expect[DST_ADDR + al->dst_offset], &mem[SRC_ADDR + al->src_offset], sizes[s]);
+                cycles[k] = call(k ? fn : ref_fn, DST_ADDR + al->dst_offset, SRC_ADDR + al->src_offset, sizes[s]);
+                verify(k ? "memcpy" : "ref_memcpy", sizes[s]);
+            }
+            report("memcpy", sizes[s], al->name, al->check_speed, cycles[0], cycles[1]);
+        }
+    }
+}
+
+static void bench_memset(uint32_t fn, uint32_t ref_fn)
+{
+    for (int a = 0; a < 2; a++)
+    {
+        const Alignment *al = &copy_aligns[a];
+        for (unsigned s = 0; s < NUM_SIZES; s++)
+        {
+            uint32_t cycles[2];
+            for (int k = 0; k < 2; k++)
+            {
+                prepare();
+                memset(&expect[DST_ADDR + al->dst_offset], 0xa5, sizes[s]);
+                cycles[k] = call(k ? fn : ref_fn, DST_ADDR + al->dst_offset, 0xa5, sizes[s]);
+                verify(k ? "memset" : "ref_memset", sizes[s]);
+            }
+            report("memset", sizes[s], al->name, al->check_speed, cycles[0], cycles[1]);
+        }
+    }
+}
+
+// Sizes are in bytes, the functions take a count of words
+static void bench_words(const char *name, uint32_t fn, uint32_t ref_fn, bool copy)
+{
+    for (int a = 0; a < 2; a++)
+    {
+        const Alignment *al = &word_aligns[a];
+        for (unsigned s = 0; s < NUM_SIZES; s++)
+        {
+            uint32_t dst = DST_ADDR + al->dst_offset;
+            uint32_t src = SRC_ADDR + al->src_offset;
+            uint32_t cycles[2];
+            for (int k = 0; k < 2; k++)
+            {
+                prepare();
+                for (uint32_t i = 0; i < sizes[s]; i += 2)
+                {
+                    if (copy)
+                    {
+                        memcpy(&expect[dst + i], &mem[src + i], 2);
+                    }
+                    else
+                    {
+                        put_be(&expect[dst + i], 2, 0x1234);
+                    }
+                }
+                cycles[k] = call(k ? fn : ref_fn, dst, copy ? src : 0x1234, sizes[s] / 2);
+                verify(name, sizes[s]);
+            }
+            report(name, sizes[s], al->name, al->check_speed, cycles[0], cycles[1]);
+        }
+    }
+}
+
+static void bench_strlen(uint32_t fn, uint32_t ref_fn)
+{
+    for (int a = 0; a < 2; a++)
+    {
+        const Alignment *al = &copy_aligns[a];
+        for (unsigned s = 0; s < NUM_SIZES; s++)
+        {
+            uint32_t str = SRC_ADDR + al->src_offset;
+            uint32_t cycles[2];
+            for (int k = 0; k < 2; k++)
+            {
+                prepare();
+                for (uint32_t i = 0; i < sizes[s]; i++) mem[str + i] = 'A' + (i % 26);
+                mem[str + sizes[s]] = '\0';
+                memcpy(expect, mem, MEM_SIZE);
+
+                cycles[k] = call(k ? fn : ref_fn, str, 0, 0);
+                uint32_t len = m68k_get_reg(NULL, M68K_REG_D0);
+                if (len != sizes[s])
+                {
+                    printf("%s returned %u for %u\n", k ? "strlen" : "ref_strlen", len, sizes[s]);
+                    failures++;
+                }
+            }
+            report("strlen", sizes[s], al->name, al->check_speed, cycles[0], cycles[1]);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <MEMBENCH.ELF>\n", argv[0]);
+        return -1;
+    }
+
+    if (!load_elf(argv[1])) return -1;
+
+    // Reset vectors, then step over the nop so the reset is not counted
+    put_be(&mem[0], 4, STACK_TOP);
+    put_be(&mem[4], 4, RETURN_ADDR);
+    put_be(&mem[RETURN_ADDR], 2, 0x4e71);
+
+    m68k_set_cpu_type(M68K_CPU_TYPE_68000);
+    m68k_init();
+    m68k_pulse_reset();
+    m68k_execute(1);
+
+    printf("%-8s %6s %-6s %9s %9s %7s\n", "Kernel", "Bytes", "Align", "Loop", "mem.c", "Speedup");
+
+    bench_memcpy(elf_symbol("memcpy"), elf_symbol("ref_memcpy"));
+    bench_memset(elf_symbol("memset"), elf_symbol("ref_memset"));
+    bench_words("memsetw", elf_symbol("memsetw"), elf_symbol("ref_memsetw"), false);
+    bench_words("memcpyw", elf_symbol("memcpyw"), elf_symbol("ref_memcpyw"), true);
+    bench_strlen(elf_symbol("strlen"), elf_symbol("ref_strlen"));
+
+    if (failures)
+    {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+// 68000 side of the memory benchmark. These are the plain byte and word loops
+// that util.h used before mem.c, kept as the baseline that membench times the
+// mem.c kernels against. It is linked with mem.c into an image that membench
+// loads, nothing here is part of the firmware.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BENCH __attribute__((noinline, used))
+
+BENCH void ref_memset(void *ptr, int c, size_t len)
+{
+    uint8_t *p = (uint8_t *)ptr;
+    while( len )
+    {
+        *p = c;
+        p++;
+        len--;
+    }
+}
+
+BENCH void ref_memsetw(void *ptr, uint16_t c, size_t len)
+{
+    uint16_t *p = (uint16_t *)ptr;
+    while( len )
+    {
+        *p = c;
+        p++;
+        len--;
+    }
+}
+
+BENCH void ref_memcpy(void *a, const void *b, size_t len)
+{
+    uint8_t *p_a = (uint8_t *)a;
+    uint8_t *p_b = (uint8_t *)b;
+
+    while( len )
+    {
+        *p_a = *p_b;
+        p_a++;
+        p_b++;
+        len--;
+    }
+}
+
+BENCH void ref_memcpyw(void *a, const void *b, size_t len)
+{
+    uint16_t *p_a = (uint16_t *)a;
+    uint16_t *p_b = (uint16_t *)b;
+
+    while( len )
+    {
+        *p_a = *p_b;
+        p_a++;
+        p_b++;
+        len--;
+    }
+}
+
+BENCH size_t ref_strlen(const char *s)
+{
+    const char *p = s;
+    while(*p) { p++; }
+    return p - s;
+}
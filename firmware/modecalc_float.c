@@ -0,0 +1,254 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "modecalc_float.h"
+#include "modes.h"
+
+static uint32_t getPLLdiv(uint32_t div)
+{
+	if (div & 1) return 0x20000 | (((div / 2) + 1) << 8) | (div / 2);
+	return ((div / 2) << 8) | (div / 2);
+}
+
+static int findPLLpar(double Fout, uint32_t *pc, uint32_t *pm, double *pko)
+{
+	uint32_t c = 1;
+	while ((Fout*c) < 400) c++;
+
+	while (1)
+	{
+		double fvco = Fout*c;
+		uint32_t m = (uint32_t)(fvco / 50);
+		double ko = ((fvco / 50) - m);
+
+		fvco = ko + m;
+		fvco *= 50.f;
+
+		if (ko && (ko <= 0.05f || ko >= 0.95f))
+		{
+			//printf("Fvco=%f, C=%d, M=%d, K=%f ", fvco, c, m, ko);
+			if (fvco > 1500.f)
+			{
+				//printf("-> No exact parameters found\n");
+				return 0;
+			}
+			//printf("-> K is outside allowed range\n");
+			c++;
+		}
+		else
+		{
+			*pc = c;
+			*pm = m;
+			*pko = ko;
+			return 1;
+		}
+	}
+
+	//will never reach here
+	return 0;
+}
+
+static void pll_calc(double Fout, PLLConfig *pll)
+{
+	double ko;
+	uint32_t m, c;
+
+	if (!findPLLpar(Fout, &c, &m, &ko))
+	{
+		c = 1;
+		while ((Fout*c) < 400) c++;
+
+		double fvco = Fout*c;
+		m = (uint32_t)(fvco / 50);
+		ko = ((fvco / 50) - m);
+
+		//Make sure K is in allowed range.
+		if (ko <= 0.05f)
+		{
+			ko = 0;
+		}
+		else if (ko >= 0.95f)
+		{
+			m++;
+			ko = 0;
+		}
+	}
+
+	pll->m = getPLLdiv(m);
+	pll->c = getPLLdiv(c);
+	pll->k = ko ? (uint32_t)(ko * 4294967296) : 1;
+}
+
+static const int CELL_GRAN_RND = 4;
+
+static int determine_vsync(int w, int h)
+{
+    const int arx[] =   {4, 16, 16, 5, 15};
+    const int ary[] =   {3,  9, 10, 4, 9 };
+	const int vsync[] = {4,  5,  6, 7, 7 };
+
+    for (int ar = 0; ar < 5; ar++)
+    {
+        int w_calc = ((h * arx[ar]) / (ary[ar] * CELL_GRAN_RND)) * CELL_GRAN_RND;
+        if (w_calc == w)
+        {
+            return vsync[ar];
+        }
+    }
+
+    return 10;
+}
+
+static void calculate_cvt(int h_pixels, int v_lines, float refresh_rate, bool reduced_blanking, VideoMode *vmode)
+{
+	// Based on xfree86 cvt.c and https://tomverbeure.github.io/video_timings_calculator
+
+	const int MIN_V_BPORCH = 6;
+	const int V_FRONT_PORCH = 3;
+
+	const int h_pixels_rnd = (h_pixels / CELL_GRAN_RND) * CELL_GRAN_RND;
+	const int v_sync = determine_vsync(h_pixels_rnd, v_lines);
+
+	int v_back_porch;
+	int h_blank, h_sync, h_back_porch, h_front_porch;
+
+	if (reduced_blanking)
+	{
+		const int RB_V_FPORCH = 3;
+		const float RB_MIN_V_BLANK = 460.0f;
+
+		float h_period_est = ((1000000.0f / refresh_rate) - RB_MIN_V_BLANK) / (float)v_lines;
+		h_blank = 160;
+
+		int vbi_lines = (int)(RB_MIN_V_BLANK / h_period_est) + 1;
+
+		int rb_min_vbi = RB_V_FPORCH + v_sync + MIN_V_BPORCH;
+		int act_vbi_lines = (vbi_lines < rb_min_vbi) ? rb_min_vbi : vbi_lines;
+
+		v_back_porch = act_vbi_lines - V_FRONT_PORCH - v_sync;
+
+		h_sync = 32;
+		h_back_porch = 80;
+		h_front_porch = h_blank - h_sync - h_back_porch;
+	}
+	else
+	{
+		const float MIN_VSYNC_BP = 550.0f;
+		const float C_PRIME = 30.0f;
+		const float M_PRIME = 300.0f;
+		const float H_SYNC_PER = 0.08f;
+
+		const float h_period_est = ((1.0f / refresh_rate) - MIN_VSYNC_BP / 1000000.0f) / (float)(v_lines + V_FRONT_PORCH) * 1000000.0f;
+
+		int v_sync_bp = (int)(MIN_VSYNC_BP / h_period_est) + 1;
+		if (v_sync_bp < (v_sync + MIN_V_BPORCH))
+		{
+			v_sync_bp = v_sync + MIN_V_BPORCH;
+		}
+
+		v_back_porch = v_sync_bp - v_sync;
+
+		float ideal_duty_cycle = C_PRIME - (M_PRIME * h_period_est / 1000.0f);
+
+		if (ideal_duty_cycle < 20)
+		{
+			h_blank = (h_pixels_rnd / 4 / (2 * CELL_GRAN_RND)) * (2 * CELL_GRAN_RND);
+		}
+		else
+		{
+			h_blank = (int)((float)h_pixels_rnd * ideal_duty_cycle / (100.0f - ideal_duty_cycle) / (2 * CELL_GRAN_RND)) * (2 * CELL_GRAN_RND);
+		}
+
+		int total_pixels = h_pixels_rnd + h_blank;
+
+		h_sync = (int)(H_SYNC_PER * (float)total_pixels / CELL_GRAN_RND) * CELL_GRAN_RND;
+		h_back_porch = h_blank / 2;
+		h_front_porch = h_blank - h_sync - h_back_porch;
+	}
+
+	vmode->hact = h_pixels_rnd;
+	vmode->hfp = h_front_porch;
+	vmode->hs = h_sync;
+	vmode->hbp = h_back_porch;
+	vmode->vact = v_lines;
+	vmode->vfp = V_FRONT_PORCH - 1;
+	vmode->vs = v_sync;
+	vmode->vbp = v_back_porch + 1;
+}
+
+static uint32_t pixel_khz(const VideoMode *mode, uint32_t millihz)
+{
+    return ((uint64_t)video_mode_pixels(mode) * millihz) / 1000000;
+}
+
+bool float_hdmi_calc_mode(uint16_t width, uint16_t height, uint32_t millihz, ModeTiming *timing)
+{
+    bool rb = (width * height) > ( 1920 * 1080);
+    float hz = millihz / 1000.0f;
+
+    calculate_cvt(width, height, hz, rb, &timing->mode);
+    timing->mode.khz = pixel_khz(&timing->mode, millihz);
+
+    if (!rb && timing->mode.khz > HDMI_MAX_KHZ)
+    {
+        calculate_cvt(width, height, hz, true, &timing->mode);
+        timing->mode.khz = pixel_khz(&timing->mode, millihz);
+    }
+
+    if (timing->mode.khz > HDMI_MAX_KHZ)
+    {
+        static const ModeTiming unavailable = { 0 };
+        *timing = unavailable;
+        return false;
+    }
+
+    double mhz = video_mode_pixels(&timing->mode) * hz;
+    mhz /= 1000000.0;
+
+    pll_calc(mhz, &timing->pll);
+    return true;
+}
+
+static void core_calc(const VideoMode *mode, uint32_t millihz, int clock_mul, ModeTiming *timing)
+{
+    float hz = millihz / 1000.0f;
+
+    timing->mode = *mode;
+    timing->mode.khz = pixel_khz(&timing->mode, millihz);
+
+    uint32_t pixels = video_mode_pixels(&timing->mode);
+    float pixel_mhz = (hz * pixels) / 1000000.0;
+
+    float mhz = pixel_mhz * clock_mul;
+    pll_calc(mhz, &timing->pll);
+}
+
+void float_core_calc_mode(uint32_t millihz, bool wide, ModeTiming *timing)
+{
+    // Core clock runs at 4x the pixel clock
+    core_calc(&core_modes[wide ? 1 : 0], millihz, 4, timing);
+}
+
+void float_core_calc_native_mode(uint32_t millihz, ModeTiming *timing)
+{
+    // Core clock runs at 2x the pixel clock
+    core_calc(&core_native_mode, millihz, 2, timing);
+}
+
+void float_core_calc_interlaced_mode(uint32_t millihz, bool pal, ModeTiming *timing)
+{
+    const VideoMode *field = &core_interlaced_modes[pal ? 1 : 0];
+    VideoMode frame = *field;
+
+    frame.vact = (field->vact * 2) + 1;
+    frame.vfp = field->vfp * 2;
+    frame.vs = field->vs * 2;
+    frame.vbp = field->vbp * 2;
+
+    // Core clock runs at 2x the pixel clock
+    core_calc(&frame, millihz / 2, 2, timing);
+
+    uint32_t khz = timing->mode.khz;
+    timing->mode = *field;
+    timing->mode.khz = khz;
+}
@@ -0,0 +1,19 @@
+#if !defined(MODECALC_FLOAT_H)
+#define MODECALC_FLOAT_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "modecalc.h"
+
+// Float reference for modecalc.c, the CVT and PLL code as it was written
+// before it moved to integer arithmetic. It is only built on the host, to
+// check the firmware mode tables and the integer code against it. It must be
+// built with -ffp-contract=off so each float step is rounded on its own.
+
+bool float_hdmi_calc_mode(uint16_t width, uint16_t height, uint32_t millihz, ModeTiming *timing);
+void float_core_calc_mode(uint32_t millihz, bool wide, ModeTiming *timing);
+void float_core_calc_native_mode(uint32_t millihz, ModeTiming *timing);
+void float_core_calc_interlaced_mode(uint32_t millihz, bool pal, ModeTiming *timing);
+
+#endif // MODECALC_FLOAT_H
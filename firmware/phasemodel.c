@@ -0,0 +1,111 @@
+// Host model of the phase lock. It runs the control loop in phaseloop.c
+// against a simulated core clock that is off from the HDMI clock by a fixed
+// amount and is trimmed by the loop, with the update running every frame or
+// only every few frames as it does when drawing is slow. The frame stamps get
+// a few ticks of jitter. Each case starts half a frame from the target and
+// must lock without going past the target by more than a line.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "phaseloop.h"
+
+#define PERIOD_TICKS 166667.0   // 60Hz core frame
+#define LINES 263
+#define TARGET_LINES 8
+#define MAX_FRAMES 3000
+#define MAX_OVERSHOOT_TICKS (PERIOD_TICKS / LINES)
+#define JITTER_TICKS 2
+
+typedef struct
+{
+    const char *name;
+    double mismatch_ppm;  // core clock faster than nominal
+    int hdmi_frames;      // HDMI frames per core frame
+    int interval;         // core frames between updates, 0 for a random 1 to 5
+} ModelCase;
+
+static const ModelCase cases[] =
+{
+    { "every frame, core fast", 300, 1, 1 },
+    { "every frame, core slow", -300, 1, 1 },
+    { "every 2 frames", 300, 1, 2 },
+    { "every 4 frames", 300, 1, 4 },
+    { "every 1 to 5 frames", 300, 1, 0 },
+    { "120Hz HDMI, every 3 frames", -150, 2, 3 },
+    { "fast core at the trim limit", 1900, 1, 1 },
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+static bool run_case(const ModelCase *c)
+{
+    double hdmi_period = PERIOD_TICKS / c->hdmi_frames;
+    uint32_t target = (uint32_t)(PERIOD_TICKS * TARGET_LINES / LINES);
+
+    PhaseLoop loop;
+    phase_loop_init(&loop, (uint32_t)PERIOD_TICKS, (uint32_t)hdmi_period, target);
+
+    // Start half an HDMI frame away from the target
+    double core_start = 1000000.0;
+    double hdmi_start = core_start + target + (hdmi_period / 2) - 1;
+    while (hdmi_start > core_start) hdmi_start -= hdmi_period;
+    uint32_t core_count = 0, last_count = 0;
+
+    int32_t first_error = 0;
+    int32_t overshoot = 0;
+    int lock_frame = -1;
+    int next_update = 1;
+    int32_t ppb = 0;
+
+    srand(1);
+
+    for (int frame = 1; frame <= MAX_FRAMES; frame++)
+    {
+        double freq = (1.0 + (c->mismatch_ppm / 1e6)) * (1.0 - (ppb / 1e9));
+        core_start += PERIOD_TICKS / freq;
+        core_count++;
+
+        // The main loop runs a little after the core frame starts
+        double now = core_start + (PERIOD_TICKS / 10);
+        while (hdmi_start + hdmi_period <= now) hdmi_start += hdmi_period;
+
+        if (frame < next_update) continue;
+        next_update = frame + (c->interval ? c->interval : 1 + (rand() % 5));
+
+        uint32_t core_ticks = (uint64_t)core_start + (rand() % (JITTER_TICKS * 2 + 1)) - JITTER_TICKS;
+        uint32_t hdmi_ticks = (uint64_t)hdmi_start + (rand() % (JITTER_TICKS * 2 + 1)) - JITTER_TICKS;
+        ppb = phase_loop_update(&loop, core_ticks, hdmi_ticks, core_count - last_count);
+        last_count = core_count;
+
+        if (first_error == 0) first_error = loop.error_ticks;
+
+        // Overshoot is error on the far side of the target from where it started
+        int32_t past = first_error > 0 ? -loop.error_ticks : loop.error_ticks;
+        if (past > overshoot) overshoot = past;
+
+        if (loop.locked && lock_frame < 0) lock_frame = frame;
+        if (!loop.locked) lock_frame = -1;
+    }
+
+    bool ok = lock_frame >= 0 && overshoot <= MAX_OVERSHOOT_TICKS;
+
+    printf("%-28s start %7d  locked %5d  overshoot %5d  trim %5.0f ppm  error %3d  %s\n",
+            c->name, first_error, lock_frame, overshoot, loop.trim_ppb / 1000.0, loop.error_ticks,
+            ok ? "ok" : "FAILED");
+
+    return ok;
+}
+
+int main()
+{
+    int failures = 0;
+
+    for (unsigned i = 0; i < NUM_CASES; i++)
+    {
+        if (!run_case(&cases[i])) failures++;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#include "analog.h"
+#include "clock.h"
+
+typedef volatile struct
+{
+    uint16_t ctrl;
+    uint16_t div;
+    uint16_t pre;
+    uint16_t count;
+    uint32_t trigger_ticks;
+    uint16_t pre_count;
+} AnalogRegs;
+
+#define ANALOG_ARMED 0x0001
+#define ANALOG_RUNNING 0x0002
+#define ANALOG_DONE 0x0004
+
+static AnalogRegs *analog_regs = (AnalogRegs *)0x950000;
+static volatile uint16_t *analog_buf = (volatile uint16_t *)0x952000;
+
+static uint16_t analog_div = ANALOG_DEFAULT_DIV;
+
+void analog_config(uint16_t div, uint16_t pre)
+{
+    analog_div = div;
+    analog_regs->div = div;
+    analog_regs->pre = pre;
+}
+
+void analog_arm()
+{
+    analog_regs->ctrl = ANALOG_ARMED;
+}
+
+void analog_disarm()
+{
+    analog_regs->ctrl = 0;
+}
+
+bool analog_done()
+{
+    return (analog_regs->ctrl & ANALOG_DONE) != 0;
+}
+
+uint16_t analog_count()
+{
+    return analog_regs->count;
+}
+
+uint16_t analog_pre_count()
+{
+    return analog_regs->pre_count;
+}
+
+uint16_t analog_entry(uint16_t index)
+{
+    return analog_buf[index];
+}
+
+uint32_t analog_trigger_ticks()
+{
+    return analog_regs->trigger_ticks;
+}
+
+const uint16_t *analog_samples()
+{
+    // Dropping volatile is safe while DONE is set, the hardware only writes
+    // the buffer again after the next analog_arm
+    return (const uint16_t *)analog_buf;
+}
+
+uint32_t analog_entry_ticks()
+{
+    return (CLOCK_REF_HZ / ANALOG_ADC_HZ) * (analog_div + 1);
+}
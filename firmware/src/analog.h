@@ -0,0 +1,46 @@
+#if !defined( ANALOG_H )
+#define ANALOG_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Analog sensor capture through the ADC, started by the next test patch
+// commit. Each entry is the sum of div + 1 12-bit ADC samples. Entries are
+// recorded from arming, so the capture can keep some from before the commit.
+
+#define ANALOG_ADC_HZ 500000
+#define ANALOG_MAX_ENTRIES 4096
+
+// 5 samples per entry, 10us per entry for 40.96ms
+#define ANALOG_DEFAULT_DIV 4
+#define ANALOG_MAX_DIV 15
+
+// An eighth of the buffer from before the commit
+#define ANALOG_DEFAULT_PRE 512
+#define ANALOG_MAX_PRE 2047
+
+// div sets the number of ADC samples per entry, minus one, at most 15. pre is
+// the number of entries to keep from before the commit. Only change them while
+// no capture is running.
+void analog_config(uint16_t div, uint16_t pre);
+
+void analog_arm();
+void analog_disarm();
+bool analog_done();
+
+uint16_t analog_count();
+
+// Entries kept from before the commit, at most the configured pre. Fewer are
+// kept when the commit comes soon after arming.
+uint16_t analog_pre_count();
+uint16_t analog_entry(uint16_t index);
+uint32_t analog_trigger_ticks();
+
+// The capture buffer itself in capture order. Only read it while analog_done()
+// is true, the next analog_arm starts overwriting it.
+const uint16_t *analog_samples();
+
+// Entry period in 10MHz ticks
+uint32_t analog_entry_ticks();
+
+#endif // ANALOG_H
@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "analog.h"
+#include "response.h"
+#include "analogmode.h"
+#include "main.h"
+
+// Analog response alternates the patch between black and white and captures
+// the analog sensor after each change, measuring the 10% to 90% transition.
+// The capture is armed a frame before the change to record the level before
+// it, and the window is widened when the transition does not settle in time.
+#define ANALOG_STEP_TICKS CLOCK_MS_TO_TICKS(500)
+#define ANALOG_LINES 6
+
+// 10us, 20us and 32us per entry, for windows of 41ms, 82ms and 131ms
+#define ANALOG_NUM_DIVS 3
+static const uint16_t analog_divs[ANALOG_NUM_DIVS] = { ANALOG_DEFAULT_DIV, 9, ANALOG_MAX_DIV };
+
+typedef struct
+{
+    bool white;
+    bool pending;
+    volatile bool flash_pending;
+    uint32_t step_ticks;
+    uint16_t div_idx;
+    bool valid[2];
+    StepResponse result[2];
+} Analog;
+
+static Analog analog;
+
+volatile bool analog_running = false;
+
+static void analog_step()
+{
+    analog.white = !analog.white;
+    analog.pending = true;
+    analog.step_ticks = clock_get_ticks();
+
+    analog_arm();
+    analog.flash_pending = true;
+}
+
+// Runs from the vblank interrupt, so the patch changes from the start of the
+// next frame, the frame the capture trigger stamps as the commit.
+void analog_vblank()
+{
+    if (!analog.flash_pending) return;
+
+    palette_ram[0x80] = analog.white ? 0xffff : 0x0000;
+    analog.flash_pending = false;
+}
+
+void analog_start()
+{
+    memset(&analog, 0, sizeof(analog));
+    analog_config(analog_divs[0], ANALOG_DEFAULT_PRE);
+    analog_running = true;
+    analog_step();
+}
+
+void analog_stop()
+{
+    analog_running = false;
+    analog_disarm();
+    palette_ram[0x80] = 0x0000;
+    waveform_reset();
+    set_state(ST_CLEAR);
+}
+
+static void analog_update()
+{
+    if (analog.pending && !analog.flash_pending && analog_done())
+    {
+        StepResponse r;
+        uint16_t count = analog_count();
+        analog.pending = false;
+
+        bool found = response_analyze(analog_samples(), count, analog_pre_count(), &r) && r.rising == analog.white;
+
+        // A step still moving in the last quarter of the window may not have settled
+        uint32_t late = (uint32_t)(count - analog_pre_count()) * 3 / 4;
+        if ((!found || r.t90 > (late << RESPONSE_FRAC_BITS)) && analog.div_idx + 1 < ANALOG_NUM_DIVS)
+        {
+            // Results are in entries of the old window, start over with the longer one
+            analog.div_idx++;
+            analog.valid[0] = analog.valid[1] = false;
+            analog_config(analog_divs[analog.div_idx], ANALOG_DEFAULT_PRE);
+        }
+        else if (found)
+        {
+            analog.result[r.rising ? 0 : 1] = r;
+            analog.valid[r.rising ? 0 : 1] = true;
+        }
+    }
+
+    if (!analog.pending && (clock_get_ticks() - analog.step_ticks) >= ANALOG_STEP_TICKS)
+    {
+        analog_step();
+    }
+}
+
+static uint32_t analog_to_ticks(uint32_t t)
+{
+    return (t * analog_entry_ticks()) >> RESPONSE_FRAC_BITS;
+}
+
+static void analog_draw_result(const char *name, bool valid, const StepResponse *r)
+{
+    char ms[CLOCK_MS_STR_LEN];
+    char line[25];
+
+    if (!valid)
+    {
+        snprintf(line, sizeof(line), "%s: -", name);
+        gfx_text(line);
+        gfx_newline(1);
+        return;
+    }
+
+    clock_ticks_to_ms_str(analog_to_ticks(response_time(r)), ms);
+    snprintf(line, sizeof(line), "%s: %s ms +%u.%u%%", name, ms,
+                r->overshoot_permille / 10, r->overshoot_permille % 10);
+    gfx_text(line);
+
+    clock_ticks_to_ms_str(analog_to_ticks(r->t10), ms);
+    snprintf(line, sizeof(line), "%s start: %s ms", name, ms);
+    gfx_text(line);
+}
+
+void draw_analog()
+{
+    analog_update();
+
+    draw_test_bars();
+
+    gfx_begin_window(ALIGN_MIDDLE | align_info(), 2, 0, 24, ANALOG_LINES + 2, 0);
+    gfx_pen(TEXT_BLUE);
+    gfx_text("ANALOG RESPONSE");
+    gfx_newline(1);
+    gfx_pen(TEXT_GRAY);
+    analog_draw_result("Rise", analog.valid[0], &analog.result[0]);
+    analog_draw_result("Fall", analog.valid[1], &analog.result[1]);
+    char line[25];
+    snprintf(line, sizeof(line), "Window: %u ms", (unsigned)((analog_entry_ticks() * ANALOG_MAX_ENTRIES) / CLOCK_REF_KHZ));
+    gfx_text(line);
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("Press B to exit.");
+    gfx_end_window();
+}
@@ -0,0 +1,19 @@
+#if !defined( ANALOGMODE_H )
+#define ANALOGMODE_H 1
+
+#include <stdbool.h>
+
+// Analog response screen, which steps the patch between black and white and
+// times each transition from the analog sensor capture
+
+// Set while analog response alternates the patch
+extern volatile bool analog_running;
+
+void analog_start();
+void analog_stop();
+void draw_analog();
+
+// Called from the vblank interrupt while analog_running is set
+void analog_vblank();
+
+#endif // ANALOGMODE_H
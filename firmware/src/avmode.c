@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "interrupts.h"
+#include "capture.h"
+#include "click.h"
+#include "avsync.h"
+#include "avmode.h"
+#include "main.h"
+
+// Audio video sync flashes the patch and plays a click on the same frame
+// commit, then times the light at the sensor and the sound at an audio
+// detector on a spare user port pin. The offset between the two shows the
+// extra delay a display or receiver adds to the HDMI audio.
+#define AV_LINES 12
+
+typedef struct
+{
+    bool waiting;
+    uint32_t phase_ticks;
+
+    // The patch and click wait for vblank
+    volatile bool flash_pending;
+} AvSyncMode;
+
+static AvSyncMode av;
+
+volatile bool avsync_running = false;
+
+void av_start()
+{
+    avsync_reset();
+    click_config(CLICK_DEFAULT_LENGTH);
+    input_filter_width(AUDIO_PIN, SENSOR_FILTER_CYCLES);
+    palette_ram[0x80] = 0x0000;
+
+    av.waiting = false;
+    av.phase_ticks = clock_get_ticks();
+
+    disable_interrupts();
+    intctrl_route_level6(INT_SRC_SENSOR | INT_SRC_AUDIO);
+    avsync_running = true;
+    enable_interrupts();
+}
+
+void av_stop()
+{
+    disable_interrupts();
+    avsync_running = false;
+    intctrl_route_level6(INT_SRC_SENSOR);
+    enable_interrupts();
+
+    click_disarm();
+    capture_disarm();
+    palette_ram[0x80] = 0x0000;
+    waveform_reset();
+    set_state(ST_CLEAR);
+}
+
+static void av_update()
+{
+    uint32_t now = clock_get_ticks();
+    uint32_t phase_ticks = now - av.phase_ticks;
+
+    if (!av.waiting)
+    {
+        if (phase_ticks < WAIT_CLEAR_TICKS) return;
+
+        av.flash_pending = true;
+        av.waiting = true;
+        av.phase_ticks = now;
+        return;
+    }
+
+    // Until the patch is written the capture still holds the last sample
+    bool committed = !av.flash_pending && capture_done() && !click_armed();
+    if (!(committed && avsync_complete()) && phase_ticks <= MAX_SAMPLE_TICKS) return;
+
+    disable_interrupts();
+    av.flash_pending = false;
+    enable_interrupts();
+
+    if (committed)
+        avsync_end(capture_trigger_ticks(), click_emit_ticks());
+    else
+        avsync_abort();
+
+    palette_ram[0x80] = 0x0000;
+    av.waiting = false;
+    av.phase_ticks = now;
+}
+
+// Runs from the vblank interrupt. The palette has no shadow, so the patch is
+// only written here to show it from the start of the next frame, the same
+// commit that starts the capture and the click.
+void av_vblank()
+{
+    if (!av.flash_pending) return;
+
+    avsync_begin(clock_get_ticks());
+    capture_arm();
+    click_arm();
+    palette_ram[0x80] = 0xffff;
+    av.flash_pending = false;
+}
+
+static void format_signed_ms(char *str, int32_t ticks)
+{
+    str[0] = ticks < 0 ? '-' : '+';
+    clock_ticks_to_ms_str(ticks < 0 ? -ticks : ticks, str + 1);
+}
+
+static void av_draw_stat(const char *name, const AvSyncStat *s)
+{
+    if (s->count == 0)
+    {
+        gfx_textf("%s: -", name);
+        return;
+    }
+
+    char ms[CLOCK_MS_STR_LEN + 1];
+    format_signed_ms(ms, avsync_mean(s));
+    gfx_textf("%s: %s ms", name, ms);
+}
+
+void draw_av()
+{
+    if (input_pressed() & INPUT_OK)
+    {
+        avsync_reset();
+    }
+
+    av_update();
+    const AvSyncStats *stats = avsync_stats();
+
+    draw_test_bars();
+
+    gfx_begin_window(ALIGN_MIDDLE | align_info(), 2, 0, 24, AV_LINES + 2, 0);
+    gfx_pen(TEXT_BLUE);
+    gfx_text("AUDIO VIDEO SYNC");
+    gfx_newline(1);
+    gfx_pen(TEXT_GRAY);
+    gfx_textf("Samples: %u", stats->samples);
+    gfx_textf("Missed V/A: %u/%u", stats->no_video, stats->no_audio);
+    av_draw_stat("Video", &stats->video);
+    av_draw_stat("Audio", &stats->audio);
+    av_draw_stat("Offset", &stats->offset);
+
+    if (stats->offset.count)
+    {
+        char min[CLOCK_MS_STR_LEN + 1], max[CLOCK_MS_STR_LEN + 1];
+        format_signed_ms(min, stats->offset.min_ticks);
+        format_signed_ms(max, stats->offset.max_ticks);
+        gfx_textf("Range: %s %s", min, max);
+    }
+    else
+    {
+        gfx_newline(1);
+    }
+
+    if (stats->last_valid)
+    {
+        char ms[CLOCK_MS_STR_LEN + 1];
+        format_signed_ms(ms, stats->last_offset);
+        gfx_textf("Last: %s ms", ms);
+    }
+    else
+    {
+        gfx_newline(1);
+    }
+
+    gfx_newline(1);
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("+ is audio late.");
+    gfx_text("A to restart, B to exit.");
+    gfx_end_window();
+}
@@ -0,0 +1,19 @@
+#if !defined( AVMODE_H )
+#define AVMODE_H 1
+
+#include <stdbool.h>
+
+// Audio video sync screen, which flashes the patch with a click and shows the
+// offset between light and sound measured by avsync.c
+
+// Set while audio video sync takes the sensor and audio detector edges
+extern volatile bool avsync_running;
+
+void av_start();
+void av_stop();
+void draw_av();
+
+// Called from the vblank interrupt while avsync_running is set
+void av_vblank();
+
+#endif // AVMODE_H
@@ -0,0 +1,102 @@
+#include "avsync.h"
+
+static AvSyncStats stats;
+
+static volatile bool sample_open;
+static uint32_t start_ticks;
+static volatile bool video_seen, audio_seen;
+static volatile uint32_t video_ticks, audio_ticks;
+
+void avsync_reset()
+{
+    stats = (AvSyncStats){ 0 };
+    sample_open = false;
+}
+
+void avsync_begin(uint32_t ticks)
+{
+    sample_open = false;
+    start_ticks = ticks;
+    video_seen = false;
+    audio_seen = false;
+    sample_open = true;
+}
+
+void avsync_video_edge(uint32_t ticks)
+{
+    if (!sample_open || video_seen || (int32_t)(ticks - start_ticks) < 0) return;
+
+    video_ticks = ticks;
+    video_seen = true;
+}
+
+void avsync_audio_edge(uint32_t ticks)
+{
+    if (!sample_open || audio_seen || (int32_t)(ticks - start_ticks) < 0) return;
+
+    audio_ticks = ticks;
+    audio_seen = true;
+}
+
+bool avsync_complete()
+{
+    return video_seen && audio_seen;
+}
+
+static void stat_add(AvSyncStat *s, int32_t ticks)
+{
+    if (s->count == 0 || ticks < s->min_ticks) s->min_ticks = ticks;
+    if (s->count == 0 || ticks > s->max_ticks) s->max_ticks = ticks;
+    s->total_ticks += ticks;
+    s->count++;
+}
+
+void avsync_end(uint32_t commit_ticks, uint32_t click_ticks)
+{
+    sample_open = false;
+    stats.samples++;
+    stats.last_valid = false;
+
+    // An edge before the stimulus went out was caused by something else
+    int32_t video = (int32_t)(video_ticks - commit_ticks);
+    int32_t audio = (int32_t)(audio_ticks - click_ticks);
+    bool video_ok = video_seen && video >= 0;
+    bool audio_ok = audio_seen && audio >= 0;
+
+    if (video_ok)
+        stat_add(&stats.video, video);
+    else
+        stats.no_video++;
+
+    if (audio_ok)
+        stat_add(&stats.audio, audio);
+    else
+        stats.no_audio++;
+
+    if (video_ok && audio_ok)
+    {
+        stats.last_offset = audio - video;
+        stats.last_valid = true;
+        stat_add(&stats.offset, stats.last_offset);
+    }
+}
+
+void avsync_abort()
+{
+    sample_open = false;
+    stats.samples++;
+    stats.no_video++;
+    stats.no_audio++;
+    stats.last_valid = false;
+}
+
+const AvSyncStats *avsync_stats()
+{
+    return &stats;
+}
+
+int32_t avsync_mean(const AvSyncStat *stat)
+{
+    if (stat->count == 0) return 0;
+    return (int32_t)(stat->total_ticks / (int64_t)stat->count);
+}
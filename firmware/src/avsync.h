@@ -0,0 +1,60 @@
+#if !defined( AVSYNC_H )
+#define AVSYNC_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Audio to video sync. Each sample changes the test patch and starts an audio
+// click on the same frame commit, then takes the first light edge from the
+// sensor and the first edge from the audio detector after it. The offset is
+// the audio latency minus the video latency, positive when the sound arrives
+// late. Like response.c this has no hardware dependencies, the avreplay host
+// tool runs it over files of synthetic or recorded edges.
+
+typedef struct
+{
+    uint32_t count;
+    int32_t min_ticks;
+    int32_t max_ticks;
+    int64_t total_ticks;
+} AvSyncStat;
+
+typedef struct
+{
+    uint32_t samples;   // samples ended, with or without edges
+    uint32_t no_video;  // samples the sensor missed
+    uint32_t no_audio;  // samples the audio detector missed
+
+    AvSyncStat video;   // frame commit to light
+    AvSyncStat audio;   // click emission to sound
+    AvSyncStat offset;  // audio minus video
+
+    bool last_valid;
+    int32_t last_offset;
+} AvSyncStats;
+
+void avsync_reset();
+
+// Starts a sample, edges before 'ticks' are left over from the last one
+void avsync_begin(uint32_t ticks);
+
+// Rising edges of the light sensor and the audio detector. These can run in
+// an interrupt handler while a sample is open.
+void avsync_video_edge(uint32_t ticks);
+void avsync_audio_edge(uint32_t ticks);
+
+// Both edges of the open sample have been seen
+bool avsync_complete();
+
+// Ends the open sample with the stamps of the frame commit and the click
+void avsync_end(uint32_t commit_ticks, uint32_t click_ticks);
+
+// Ends the open sample when the patch or click never went out
+void avsync_abort();
+
+const AvSyncStats *avsync_stats();
+
+// Average of a stat, zero when it is empty
+int32_t avsync_mean(const AvSyncStat *stat);
+
+#endif // AVSYNC_H
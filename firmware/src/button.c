@@ -0,0 +1,305 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "interrupts.h"
+#include "capture.h"
+#include "button.h"
+#include "main.h"
+
+// Button to photon turns the patch white as soon as a button is pressed and
+// splits the time to the sensor edge into press to frame commit and commit to
+// photon. The press comes from a switch on a spare user port pin, from the
+// gamepad through the HPS, or from both when the switch is wired across a
+// gamepad button, which also times the HPS and USB path.
+#define BUTTON_POLL_TICKS CLOCK_MS_TO_TICKS(1)
+#define BUTTON_LINES 13
+
+// Switch bounce shorter than 0.5ms is ignored
+#define BUTTON_FILTER_CYCLES (INPUT_FILTER_HZ / 2000)
+
+typedef enum { BUTTON_SWITCH, BUTTON_GAMEPAD, BUTTON_BOTH } ButtonSource;
+static const char *button_sources[3] = { "Switch", "Gamepad", "Both" };
+
+typedef enum { BUTTON_CLEAR, BUTTON_ARMED, BUTTON_PRESSED } ButtonPhase;
+
+typedef struct
+{
+    int source_idx;
+
+    volatile ButtonPhase phase;
+    volatile uint32_t phase_ticks;
+    volatile uint32_t press_ticks;
+
+    // Gamepad polling, and the gamepad stamp of a switch press with BUTTON_BOTH
+    uint16_t pad_prev;
+    uint32_t poll_ticks;
+    volatile bool pad_seen;
+
+    // The patch for a press waits for vblank
+    volatile bool flash_pending;
+    volatile uint32_t pad_ticks;
+
+    LatencyStats total;
+    LatencyStats commit;
+    LatencyStats photon;
+    LatencyStats hps;
+    uint32_t last_ticks;
+} Button;
+
+static Button button;
+
+volatile bool button_running = false;
+
+// Runs from the interrupt that saw the press
+static void button_trigger(uint32_t press_ticks)
+{
+    button.press_ticks = press_ticks;
+    button.phase_ticks = clock_get_ticks();
+    button.pad_seen = false;
+    button.flash_pending = true;
+    button.phase = BUTTON_PRESSED;
+}
+
+// Runs from the vblank interrupt. The palette has no shadow, so the patch is
+// only written here to show it from the start of the next frame, the frame
+// the capture trigger stamps as the commit.
+void button_vblank()
+{
+    if (!button.flash_pending) return;
+
+    capture_arm();
+    palette_ram[0x80] = 0xffff;
+    sample_seq++;
+    button.flash_pending = false;
+}
+
+void button_poll(uint16_t pending)
+{
+    if ((pending & INT_SRC_BUTTON) && button.source_idx != BUTTON_GAMEPAD && button.phase == BUTTON_ARMED)
+    {
+        // Both edges interrupt, only a fall newer than the last rise is a press
+        uint32_t fall = input_fall_ticks(BUTTON_PIN);
+        if ((int32_t)(fall - input_rise_ticks(BUTTON_PIN)) > 0)
+        {
+            button_trigger(fall);
+        }
+    }
+
+    if (pending & INT_SRC_TIMER0)
+    {
+        button.poll_ticks += BUTTON_POLL_TICKS;
+        clock_timer_arm(0, button.poll_ticks);
+
+        uint16_t pad = input_gamepad_now();
+        bool pressed = (pad & ~button.pad_prev & INPUT_OK) != 0;
+        button.pad_prev = pad;
+
+        if (!pressed)
+        {
+            return;
+        }
+
+        if (button.source_idx == BUTTON_GAMEPAD && button.phase == BUTTON_ARMED)
+        {
+            button_trigger(input_gamepad_ticks());
+        }
+        else if (button.source_idx == BUTTON_BOTH && button.phase == BUTTON_PRESSED && !button.pad_seen)
+        {
+            button.pad_ticks = input_gamepad_ticks();
+            button.pad_seen = true;
+        }
+    }
+}
+
+static void button_reset()
+{
+    memset(&button.total, 0, sizeof(LatencyStats));
+    memset(&button.commit, 0, sizeof(LatencyStats));
+    memset(&button.photon, 0, sizeof(LatencyStats));
+    memset(&button.hps, 0, sizeof(LatencyStats));
+}
+
+void button_start()
+{
+    button_reset();
+    palette_ram[0x80] = 0x0000;
+    input_filter_width(BUTTON_PIN, BUTTON_FILTER_CYCLES);
+
+    disable_interrupts();
+    button.phase = BUTTON_CLEAR;
+    button.phase_ticks = clock_get_ticks();
+    button.pad_prev = input_gamepad_now();
+    button.poll_ticks = button.phase_ticks + BUTTON_POLL_TICKS;
+    clock_timer_arm(0, button.poll_ticks);
+    intctrl_route_level6(INT_SRC_SENSOR | INT_SRC_BUTTON | INT_SRC_TIMER0);
+    intctrl_edge_fall(INT_SRC_BUTTON);
+    button_running = true;
+    enable_interrupts();
+}
+
+void button_stop()
+{
+    disable_interrupts();
+    button_running = false;
+    clock_timer_disarm(0);
+    intctrl_route_level6(INT_SRC_SENSOR);
+    intctrl_edge_fall(0);
+    enable_interrupts();
+
+    capture_disarm();
+    palette_ram[0x80] = 0x0000;
+    waveform_reset();
+    set_state(ST_CLEAR);
+}
+
+static void button_finish()
+{
+    uint32_t press = button.press_ticks;
+    uint32_t commit = capture_trigger_ticks();
+
+    if ((int32_t)(commit - press) < 0 || (int32_t)(sensor_ticks - commit) < 0)
+    {
+        button.total.missing++;
+        return;
+    }
+
+    button.last_ticks = sensor_ticks - press;
+    latency_stats_add(&button.total, button.last_ticks);
+    latency_stats_add(&button.commit, commit - press);
+    latency_stats_add(&button.photon, sensor_ticks - commit);
+
+    if (button.source_idx == BUTTON_BOTH)
+    {
+        if (button.pad_seen && (int32_t)(button.pad_ticks - press) >= 0)
+            latency_stats_add(&button.hps, button.pad_ticks - press);
+        else
+            button.hps.missing++;
+    }
+}
+
+static void button_update()
+{
+    // The interrupt only moves on from BUTTON_ARMED, so read the phase first
+    ButtonPhase phase = button.phase;
+    uint32_t now = clock_get_ticks();
+    uint32_t phase_ticks = now - button.phase_ticks;
+
+    if (phase == BUTTON_PRESSED)
+    {
+        // Capture done means the commit is stamped, the patch is on screen.
+        // Until the patch is written both still hold the last press.
+        bool seen = !button.flash_pending && capture_done() && sensor_seq == sample_seq;
+        bool waiting_pad = button.source_idx == BUTTON_BOTH && !button.pad_seen;
+
+        if (seen && !waiting_pad)
+        {
+            button_finish();
+        }
+        else if (phase_ticks > MAX_SAMPLE_TICKS)
+        {
+            if (seen)
+                button_finish();
+            else
+                button.total.missing++;
+        }
+        else
+        {
+            return;
+        }
+
+        button.flash_pending = false;
+        palette_ram[0x80] = 0x0000;
+        button.phase_ticks = now;
+        button.phase = BUTTON_CLEAR;
+    }
+    else if (phase == BUTTON_CLEAR && phase_ticks >= WAIT_CLEAR_TICKS)
+    {
+        button.phase = BUTTON_ARMED;
+    }
+}
+
+static void button_draw_stat(const char *name, const LatencyStats *s)
+{
+    if (s->count == 0)
+    {
+        gfx_textf("%s: -", name);
+        return;
+    }
+
+    char avg[CLOCK_MS_STR_LEN], min[CLOCK_MS_STR_LEN], max[CLOCK_MS_STR_LEN];
+    stats_to_ms(s, avg, min, max);
+    gfx_textf("%s: %s ms", name, avg);
+}
+
+void draw_button()
+{
+    if (input_pressed() & (INPUT_LEFT | INPUT_RIGHT))
+    {
+        int step = (input_pressed() & INPUT_LEFT) ? 2 : 1;
+        button.source_idx = (button.source_idx + step) % 3;
+        button_reset();
+    }
+
+    button_update();
+
+    draw_test_bars();
+
+    const LatencyStats *total = &button.total;
+
+    gfx_begin_window(ALIGN_MIDDLE | align_info(), 2, 0, 24, BUTTON_LINES + 2, 0);
+    gfx_pen(TEXT_BLUE);
+    gfx_text("BUTTON TO PHOTON");
+    gfx_newline(1);
+    gfx_pen(TEXT_GRAY);
+    gfx_textf("Source: %s", button_sources[button.source_idx]);
+    gfx_textf("Presses: %u Missed: %u", total->count, total->missing);
+
+    button_draw_stat("Total", total);
+    if (total->count)
+    {
+        char avg[CLOCK_MS_STR_LEN], min[CLOCK_MS_STR_LEN], max[CLOCK_MS_STR_LEN];
+        stats_to_ms(total, avg, min, max);
+        gfx_textf("Range: %s-%s ms", min, max);
+    }
+    else
+    {
+        gfx_newline(1);
+    }
+
+    button_draw_stat("Press>Frame", &button.commit);
+    button_draw_stat("Frame>Photon", &button.photon);
+    if (button.source_idx == BUTTON_BOTH)
+    {
+        button_draw_stat("HPS/USB", &button.hps);
+    }
+    else
+    {
+        gfx_newline(1);
+    }
+
+    if (total->count)
+    {
+        char ms[CLOCK_MS_STR_LEN];
+        clock_ticks_to_ms_str(button.last_ticks, ms);
+        gfx_textf("Last: %s ms", ms);
+    }
+    else
+    {
+        gfx_newline(1);
+    }
+
+    gfx_newline(1);
+    gfx_pen(TEXT_DARK_BLUE);
+    if (button.phase == BUTTON_ARMED)
+    {
+        gfx_text(button.source_idx == BUTTON_GAMEPAD ? "Press A." : "Press the switch.");
+    }
+    else
+    {
+        gfx_text("Wait...");
+    }
+    gfx_text("L/R source, B to exit.");
+    gfx_end_window();
+}
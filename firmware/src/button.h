@@ -0,0 +1,22 @@
+#if !defined( BUTTON_H )
+#define BUTTON_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Button to photon screen, which times a press on a switch or the gamepad to
+// the patch appearing at the sensor
+
+// Set while button to photon waits on the switch and polls the gamepad
+extern volatile bool button_running;
+
+void button_start();
+void button_stop();
+void draw_button();
+
+// Called from the vblank interrupt, and from the level 6 interrupt with the
+// sources that raised it, while button_running is set
+void button_vblank();
+void button_poll(uint16_t pending);
+
+#endif // BUTTON_H
@@ -0,0 +1,189 @@
+#include "capture.h"
+#include "gfx.h"
+#include "util.h"
+
+typedef volatile struct
+{
+    uint16_t ctrl;
+    uint16_t div;
+    uint16_t duration;
+    uint16_t count;
+    uint32_t trigger_ticks;
+} CaptureRegs;
+
+#define CAPTURE_ARMED 0x0001
+#define CAPTURE_RUNNING 0x0002
+#define CAPTURE_DONE 0x0004
+
+static CaptureRegs *capture_regs = (CaptureRegs *)0x940000;
+static volatile uint16_t *capture_buf = (volatile uint16_t *)0x942000;
+
+static uint16_t capture_div = CAPTURE_DEFAULT_DIV;
+
+void capture_config(uint16_t div, uint16_t duration)
+{
+    capture_div = div;
+    capture_regs->div = div;
+    capture_regs->duration = duration;
+}
+
+void capture_arm()
+{
+    capture_regs->ctrl = CAPTURE_ARMED;
+}
+
+void capture_disarm()
+{
+    capture_regs->ctrl = 0;
+}
+
+bool capture_done()
+{
+    return (capture_regs->ctrl & CAPTURE_DONE) != 0;
+}
+
+uint16_t capture_count()
+{
+    return capture_regs->count;
+}
+
+uint16_t capture_entry(uint16_t index)
+{
+    return capture_buf[index];
+}
+
+uint32_t capture_trigger_ticks()
+{
+    return capture_regs->trigger_ticks;
+}
+
+void capture_waveform(uint8_t *columns, int count)
+{
+    uint16_t entries = capture_count();
+    uint32_t total = 0;
+
+    memset(columns, 0, count);
+
+    for (uint16_t i = 0; i < entries; i++)
+    {
+        total += capture_buf[i] & CAPTURE_RUN_MASK;
+    }
+
+    if (total == 0) return;
+
+    uint32_t slice = (total + count - 1) / count;
+    uint32_t pos = 0;
+    for (uint16_t i = 0; i < entries; i++)
+    {
+        uint16_t e = capture_buf[i];
+        uint16_t len = e & CAPTURE_RUN_MASK;
+        uint8_t level = (e & CAPTURE_LEVEL) ? WAVE_HIGH : WAVE_LOW;
+
+        if (len == 0) continue;
+
+        int first = pos / slice;
+        int last = (pos + len - 1) / slice;
+
+        for (int c = first; c <= last; c++)
+        {
+            columns[c] |= level;
+        }
+
+        pos += len;
+    }
+}
+
+bool capture_pwm(CapturePWM *pwm)
+{
+    uint16_t entries = capture_count();
+    uint32_t pos = 0;
+    uint32_t first_edge = 0, first_rise = 0, last_rise = 0;
+    uint32_t high = 0, high_at_last_rise = 0;
+    uint16_t rises = 0;
+    bool prev_level = false;
+
+    for (uint16_t i = 0; i < entries; i++)
+    {
+        uint16_t e = capture_buf[i];
+        uint16_t len = e & CAPTURE_RUN_MASK;
+        bool level = (e & CAPTURE_LEVEL) != 0;
+
+        // Runs longer than an entry continue with the same level
+        if (level && !prev_level && i > 0)
+        {
+            rises++;
+
+            if (rises == 1)
+            {
+                first_edge = pos;
+            }
+
+            // When sampling, the first rise is the patch itself. Flicker
+            // analysis commits a patch that is already white, so there it is
+            // a PWM rise and skipping it only costs a period. Either way PWM
+            // is measured from the second.
+            if (rises == 2)
+            {
+                first_rise = pos;
+                high = 0;
+            }
+            last_rise = pos;
+            high_at_last_rise = high;
+        }
+
+        if (level) high += len;
+
+        prev_level = level;
+        pos += len;
+    }
+
+    if (rises < 4)
+    {
+        return false;
+    }
+
+    uint32_t span = last_rise - first_rise;
+    uint16_t periods = rises - 2;
+    uint32_t period = span / periods;
+
+    if (period == 0) return false;
+
+    // Keep the duty calculation within 32 bits
+    uint32_t h = high_at_last_rise;
+    while (span > 0x3fffff)
+    {
+        span >>= 1;
+        h >>= 1;
+    }
+
+    pwm->freq_hz = (CAPTURE_CLOCK_HZ / (capture_div + 1)) / period;
+    pwm->duty_permille = (h * 1000) / span;
+    pwm->periods = periods;
+    pwm->first_edge = first_edge;
+    pwm->phase = first_rise;
+    pwm->span = last_rise - first_rise;
+
+    return true;
+}
+
+uint32_t capture_gated_delay(const CapturePWM *pwm)
+{
+    uint32_t period = pwm->span / pwm->periods;
+    uint32_t tolerance = (period >> 6) + 1;
+    uint32_t offset = (pwm->phase - pwm->first_edge) % period;
+
+    if (offset > tolerance && (period - offset) > tolerance)
+    {
+        return 0;
+    }
+
+    uint32_t off_time = period - ((period * pwm->duty_permille) / 1000);
+    return off_time / 2;
+}
+
+uint32_t capture_samples_to_ticks(uint32_t samples)
+{
+    // Samples are (div + 1) / 50MHz long and ticks are 1 / 10MHz
+    uint32_t div = capture_div + 1;
+    return ((samples / 5) * div) + (((samples % 5) * div) / 5);
+}
@@ -0,0 +1,58 @@
+#if !defined( CAPTURE_H )
+#define CAPTURE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sensor waveform capture, started by the next test patch commit
+
+#define CAPTURE_CLOCK_HZ 50000000
+#define CAPTURE_MAX_ENTRIES 4096
+
+// Sample every 1us for 51.2ms by default
+#define CAPTURE_DEFAULT_DIV 49
+#define CAPTURE_DEFAULT_DURATION 200
+
+#define CAPTURE_LEVEL 0x8000
+#define CAPTURE_RUN_MASK 0x7fff
+
+typedef struct
+{
+    uint32_t freq_hz;
+    uint16_t duty_permille;
+    uint16_t periods;
+
+    uint32_t first_edge; // sample of the first rise, normally the patch itself
+    uint32_t phase;      // sample of the first PWM rise after it
+    uint32_t span;       // samples covered by 'periods' complete periods
+} CapturePWM;
+
+// div sets the sample rate to CAPTURE_CLOCK_HZ / (div + 1), duration is in
+// units of 256 samples. Only change them while no capture is running.
+void capture_config(uint16_t div, uint16_t duration);
+
+void capture_arm();
+void capture_disarm();
+bool capture_done();
+
+uint16_t capture_count();
+uint16_t capture_entry(uint16_t index);
+uint32_t capture_trigger_ticks();
+
+// Marks which levels were seen in each of 'count' equal slices of the capture
+// using WAVE_LOW and WAVE_HIGH.
+void capture_waveform(uint8_t *columns, int count);
+
+// Measures the period and duty cycle of any PWM after the initial edge.
+// Returns false when there are not enough complete periods.
+bool capture_pwm(CapturePWM *pwm);
+
+// When the first rise lines up with the PWM phase, the patch changed somewhere
+// in the preceding off phase and only became visible when the backlight came
+// back on. Returns the estimated extra delay in samples, half the off time, or
+// zero when the first rise was not gated by the PWM.
+uint32_t capture_gated_delay(const CapturePWM *pwm);
+
+uint32_t capture_samples_to_ticks(uint32_t samples);
+
+#endif // CAPTURE_H
@@ -0,0 +1,38 @@
+#include "click.h"
+
+typedef volatile struct
+{
+    uint16_t ctrl;
+    uint16_t length;
+    uint32_t emit_ticks;
+} ClickRegs;
+
+#define CLICK_ARMED 0x0001
+#define CLICK_PLAYING 0x0002
+
+static ClickRegs *click_regs = (ClickRegs *)0x960000;
+
+void click_config(uint8_t length)
+{
+    click_regs->length = length;
+}
+
+void click_arm()
+{
+    click_regs->ctrl = CLICK_ARMED;
+}
+
+void click_disarm()
+{
+    click_regs->ctrl = 0;
+}
+
+bool click_armed()
+{
+    return (click_regs->ctrl & CLICK_ARMED) != 0;
+}
+
+uint32_t click_emit_ticks()
+{
+    return click_regs->emit_ticks;
+}
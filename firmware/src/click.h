@@ -0,0 +1,24 @@
+#if !defined( CLICK_H )
+#define CLICK_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Audio click on the core's audio output, started by the next test patch
+// commit. The click is a square wave burst of about 1.2kHz.
+
+// Half periods of the square wave, each 4096 ticks
+#define CLICK_HALF_PERIOD_TICKS 4096
+#define CLICK_DEFAULT_LENGTH 24
+
+// Only change the length while no click is playing
+void click_config(uint8_t length);
+
+void click_arm();
+void click_disarm();
+bool click_armed();
+
+// Tick count at the start of the last click
+uint32_t click_emit_ticks();
+
+#endif // CLICK_H
@@ -1,7 +1,55 @@
 #include "clock.h"
 
-void clock_ticks_to_ms_us(uint32_t ticks, uint32_t *ms, uint32_t *us)
+// Divide by 10 using shifts and adds, which multiplies by an approximation of
+// 0.1 and then corrects the result from the remainder. The 68000 DIVU takes
+// ~140 cycles and can only produce a 16-bit quotient.
+static inline uint32_t div10(uint32_t n, uint32_t *rem)
 {
-    *ms = ticks / CLOCK_REF_KHZ;
-    *us = (ticks / CLOCK_REF_MHZ ) % 1000;
-}
\ No newline at end of file
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+
+    uint32_t r = n - ((q << 3) + (q << 1));
+    if (r > 9)
+    {
+        q++;
+        r -= 10;
+    }
+
+    *rem = r;
+    return q;
+}
+
+char *clock_ticks_to_ms_str(uint32_t ticks, char *str)
+{
+    char digits[CLOCK_MS_STR_LEN];
+    char *p = digits + sizeof(digits);
+    uint32_t rem;
+
+    // Drop the sub-microsecond digit
+    uint32_t us = div10(ticks, &rem);
+
+    for (int i = 0; i < 3; i++)
+    {
+        us = div10(us, &rem);
+        *--p = '0' + rem;
+    }
+
+    *--p = '.';
+
+    do
+    {
+        us = div10(us, &rem);
+        *--p = '0' + rem;
+    } while (us);
+
+    while (p < digits + sizeof(digits))
+    {
+        *str++ = *p++;
+    }
+    *str = '\0';
+
+    return str;
+}
@@ -13,7 +13,12 @@
 #define CLOCK_TICKS_TO_MS(ticks) ((ticks) / CLOCK_REF_KHZ)
 #define CLOCK_TICKS_TO_US(ticks) ((ticks) / CLOCK_REF_MHZ)
 
-void clock_ticks_to_ms_us(uint32_t ticks, uint32_t *ms, uint32_t *us);
+// Longest string written by clock_ticks_to_ms_str, including the terminator
+#define CLOCK_MS_STR_LEN 12
+
+// Formats ticks as milliseconds with three decimal places ("16.683") without
+// any division. Returns a pointer to the terminating zero.
+char *clock_ticks_to_ms_str(uint32_t ticks, char *str);
 
 
 typedef volatile struct
@@ -27,12 +32,46 @@ static inline uint32_t clock_get_ticks()
 {
     ClockTicks *ticks = (ClockTicks *)0x200000;
 
-    disable_interrupts();
+    uint16_t sr = save_disable_interrupts();
     ticks->latch = 0xffff;
     uint32_t res = ticks->value;
-    enable_interrupts();
+    restore_interrupts(sr);
 
     return res;
 }
 
+// Compare timers, each raises its interrupt source (INT_SRC_TIMER0/1) once the
+// tick counter reaches the armed compare value
+#define CLOCK_NUM_TIMERS 2
+
+#define CLOCK_TIMER_ARMED 0x0001
+#define CLOCK_TIMER_EXPIRED 0x0002
+
+typedef volatile struct
+{
+    uint32_t compare;
+    uint16_t ctrl;
+    uint16_t pad[5];
+} ClockTimer;
+
+static inline ClockTimer *clock_timer(int n)
+{
+    return (ClockTimer *)(0x200010 + (n * sizeof(ClockTimer)));
+}
+
+// Fires at an absolute tick, values up to 2^31 ticks in the past fire immediately
+static inline void clock_timer_arm(int n, uint32_t at_ticks)
+{
+    ClockTimer *timer = clock_timer(n);
+    timer->ctrl = 0; // compare is written a word at a time
+    timer->compare = at_ticks;
+    timer->ctrl = CLOCK_TIMER_ARMED;
+}
+
+// Also clears the expired state
+static inline void clock_timer_disarm(int n)
+{
+    clock_timer(n)->ctrl = 0;
+}
+
 #endif // CLOCK_H
\ No newline at end of file
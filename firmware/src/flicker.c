@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "interrupts.h"
+#include "capture.h"
+#include "flicker.h"
+#include "main.h"
+
+// Flicker analysis holds the patch white and repeatedly captures the sensor
+// for 256ms, comparing any flicker against the measured refresh rate.
+#define FLICKER_DURATION 1000
+#define FLICKER_LINES 5
+
+typedef struct
+{
+    uint32_t vblank_count;
+    uint32_t vblank_ticks;
+    bool valid;
+    char lines[FLICKER_LINES][25];
+} Flicker;
+
+static Flicker flicker;
+
+static void flicker_arm()
+{
+    disable_interrupts();
+    flicker.vblank_count = vblank_int_count;
+    flicker.vblank_ticks = vblank_int_ticks;
+    enable_interrupts();
+
+    capture_arm();
+
+    // Rewriting the patch commits it again, which triggers the capture
+    palette_ram[0x80] = 0xffff;
+}
+
+void flicker_start()
+{
+    capture_config(CAPTURE_DEFAULT_DIV, FLICKER_DURATION);
+    flicker.valid = false;
+    flicker_arm();
+}
+
+void flicker_stop()
+{
+    capture_disarm();
+    capture_config(CAPTURE_DEFAULT_DIV, CAPTURE_DEFAULT_DURATION);
+    palette_ram[0x80] = 0x0000;
+    waveform_reset();
+    set_state(ST_CLEAR);
+}
+
+// Returns n when one period is n times the other to within 1%, 0 otherwise
+static uint32_t period_ratio(uint32_t a, uint32_t b)
+{
+    uint32_t long_p = a > b ? a : b;
+    uint32_t short_p = a > b ? b : a;
+
+    if (short_p == 0) return 0;
+
+    uint32_t n = (long_p + (short_p / 2)) / short_p;
+    if (n == 0 || n > 8) return 0;
+
+    uint32_t nearest = n * short_p;
+    uint32_t diff = long_p > nearest ? long_p - nearest : nearest - long_p;
+
+    return (diff * 100) <= long_p ? n : 0;
+}
+
+static void flicker_update()
+{
+    if (!capture_done()) return;
+
+    disable_interrupts();
+    uint32_t frames = vblank_int_count - flicker.vblank_count;
+    uint32_t elapsed = vblank_int_ticks - flicker.vblank_ticks;
+    enable_interrupts();
+
+    uint32_t refresh_ticks = frames ? elapsed / frames : 0;
+
+    CapturePWM pwm;
+    if (refresh_ticks && capture_pwm(&pwm))
+    {
+        uint32_t period_ticks = capture_samples_to_ticks(pwm.span) / pwm.periods;
+        uint32_t freq_dhz = period_ticks ? (CLOCK_REF_HZ * 10) / period_ticks : 0;
+        uint32_t n = period_ratio(period_ticks, refresh_ticks);
+
+        snprintf(flicker.lines[0], 25, "Flicker: %u.%u Hz", freq_dhz / 10, freq_dhz % 10);
+        snprintf(flicker.lines[1], 25, "Duty: %u.%u%%", pwm.duty_permille / 10, pwm.duty_permille % 10);
+        if (n == 0)
+            strcpy(flicker.lines[2], "Type: PWM (free running)");
+        else if (n == 1)
+            strcpy(flicker.lines[2], "Type: BFI (1x refresh)");
+        else if (period_ticks < refresh_ticks)
+            snprintf(flicker.lines[2], 25, "Type: BFI (%ux refresh)", n);
+        else
+            snprintf(flicker.lines[2], 25, "Type: BFI (1/%u refresh)", n);
+    }
+    else
+    {
+        strcpy(flicker.lines[0], "Flicker: None");
+        strcpy(flicker.lines[1], "");
+        strcpy(flicker.lines[2], "");
+    }
+
+    uint32_t refresh_chz = refresh_ticks ? (CLOCK_REF_HZ * 100) / refresh_ticks : 0;
+    snprintf(flicker.lines[3], 25, "Refresh: %u.%02u Hz", refresh_chz / 100, refresh_chz % 100);
+    strcpy(flicker.lines[4], "Press B to exit.");
+
+    flicker.valid = true;
+
+    flicker_arm();
+}
+
+void draw_flicker()
+{
+    flicker_update();
+
+    draw_test_bars();
+
+    gfx_begin_window(ALIGN_MIDDLE | align_info(), 2, 0, 24, FLICKER_LINES + 2, 0);
+    gfx_pen(TEXT_BLUE);
+    gfx_text("FLICKER ANALYSIS");
+    gfx_newline(1);
+    if (flicker.valid)
+    {
+        for (int i = 0; i < FLICKER_LINES; i++)
+        {
+            gfx_pen(i == FLICKER_LINES - 1 ? TEXT_DARK_BLUE : TEXT_GRAY);
+            gfx_text(flicker.lines[i]);
+        }
+    }
+    else
+    {
+        gfx_pen(TEXT_GRAY);
+        gfx_text("Measuring...");
+    }
+    gfx_end_window();
+}
@@ -0,0 +1,11 @@
+#if !defined( FLICKER_H )
+#define FLICKER_H 1
+
+// Flicker analysis screen, which measures PWM or BFI flicker of the display
+// against its refresh rate
+
+void flicker_start();
+void flicker_stop();
+void draw_flicker();
+
+#endif // FLICKER_H
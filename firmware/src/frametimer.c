@@ -0,0 +1,31 @@
+#include "frametimer.h"
+#include "clock.h"
+
+void frame_window_start(FrameWindow *w, const FrameStamp *stamp)
+{
+    w->start_count = stamp->count;
+    w->frames = 0;
+    w->last_ticks = stamp->last_ticks;
+    w->span_ticks = 0;
+}
+
+void frame_window_update(FrameWindow *w, const FrameStamp *stamp)
+{
+    w->frames = stamp->count - w->start_count;
+    w->span_ticks += stamp->last_ticks - w->last_ticks;
+    w->last_ticks = stamp->last_ticks;
+}
+
+uint32_t frame_window_uhz(const FrameWindow *w)
+{
+    if (w->frames < 2 || w->span_ticks == 0) return 0;
+
+    return ((uint64_t)w->frames * CLOCK_REF_HZ * 1000000) / w->span_ticks;
+}
+
+int32_t frame_rate_ppm_x10(uint32_t uhz, uint32_t ref_uhz)
+{
+    if (ref_uhz == 0) return 0;
+
+    return (((int64_t)uhz - (int64_t)ref_uhz) * 10000000) / ref_uhz;
+}
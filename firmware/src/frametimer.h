@@ -0,0 +1,90 @@
+#if !defined( FRAMETIMER_H )
+#define FRAMETIMER_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "interrupts.h"
+
+// Hardware timestamps of the start of the active area of the core video and
+// the HDMI output, in ticks
+
+#define FRAME_SRC_CORE 0
+#define FRAME_SRC_HDMI 1
+#define FRAME_NUM_SOURCES 2
+
+#define FRAME_TIMER_SNAPSHOT 0x0001
+#define FRAME_TIMER_CLEAR 0x0002
+
+typedef struct
+{
+    uint32_t count;      // frames since reset
+    uint32_t last_ticks; // start of the latest frame
+    uint32_t min_period; // shortest and longest frame since the periods were cleared
+    uint32_t max_period;
+} FrameStamp;
+
+typedef volatile struct
+{
+    uint16_t ctrl;
+    uint16_t pad[7];
+    FrameStamp src[FRAME_NUM_SOURCES];
+} FrameTimer;
+
+#define FRAME_TIMER ((FrameTimer *)0x200040)
+
+static inline void frame_timer_read(FrameStamp *stamps)
+{
+    uint16_t sr = save_disable_interrupts();
+    FRAME_TIMER->ctrl = FRAME_TIMER_SNAPSHOT;
+    for (int i = 0; i < FRAME_NUM_SOURCES; i++)
+    {
+        stamps[i].count = FRAME_TIMER->src[i].count;
+        stamps[i].last_ticks = FRAME_TIMER->src[i].last_ticks;
+        stamps[i].min_period = FRAME_TIMER->src[i].min_period;
+        stamps[i].max_period = FRAME_TIMER->src[i].max_period;
+    }
+    restore_interrupts(sr);
+}
+
+// Start of the latest frame of one source
+static inline uint32_t frame_timer_last(int src)
+{
+    uint16_t sr = save_disable_interrupts();
+    FRAME_TIMER->ctrl = FRAME_TIMER_SNAPSHOT;
+    uint32_t ticks = FRAME_TIMER->src[src].last_ticks;
+    restore_interrupts(sr);
+
+    return ticks;
+}
+
+static inline void frame_timer_clear_periods()
+{
+    FRAME_TIMER->ctrl = FRAME_TIMER_CLEAR;
+}
+
+// A measurement window over one source. The tick count wraps every 2^32
+// ticks, about 7 minutes, so the span is kept in 64 bits by adding up the
+// time between updates, which must come less than that apart.
+typedef struct
+{
+    uint32_t start_count;
+    uint32_t frames;
+    uint32_t last_ticks;
+    uint64_t span_ticks;
+} FrameWindow;
+
+void frame_window_start(FrameWindow *w, const FrameStamp *stamp);
+void frame_window_update(FrameWindow *w, const FrameStamp *stamp);
+
+// Average refresh rate in microhertz over a window, zero if it covers fewer
+// than two frames. The 64-bit intermediate limits the window to 2^20 frames,
+// about 4.8 hours at 60Hz.
+#define FRAME_MAX_WINDOW (1UL << 20)
+
+uint32_t frame_window_uhz(const FrameWindow *w);
+
+// Difference between two rates in tenths of a part per million of 'ref_uhz'
+int32_t frame_rate_ppm_x10(uint32_t uhz, uint32_t ref_uhz);
+
+#endif // FRAMETIMER_H
@@ -5,6 +5,8 @@
 #include "input.h"
 #include "util.h"
 #include "hdmi.h"
+#include "modes.h"
+#include "interrupts.h"
 #include "printf/printf.h"
 
 #define TILE_MAX_W 128
@@ -20,14 +22,33 @@
 #define CHR_BOT 14
 #define CHR_LEFT 22
 #define CHR_RIGHT 2
+#define CHR_LOWER_HALF 21
 
 
 typedef struct
 {
     uint16_t hofs;
     uint16_t vofs;
+
+    uint16_t region_vstart;
+    uint16_t region_vend;
+    uint16_t region_hofs;
+    uint16_t region_vofs;
+
+    uint16_t next_hofs;
+    uint16_t next_vofs;
+    volatile uint16_t flip;
+    uint16_t pad[7];
+    uint16_t ctrl;
+    uint16_t field_hofs;
 } TilemapCtrl;
 
+#define FLIP_PENDING 0x8000
+#define FLIP_FRONT_MASK 0x00ff
+
+#define TILEMAP_DOUBLE_H 0x0001
+#define TILEMAP_DOUBLE_V 0x0002
+
 typedef struct
 {
     uint16_t value;
@@ -44,11 +65,20 @@ typedef struct
 TilemapCtrl *tile_ctrl = (TilemapCtrl *)0x910000;
 Blitter *blitter = (Blitter *)0x930000;
 
-TilemapCtrl page_tile_ctrl[2];
-uint16_t *page_vram[2];
+#define NUM_PAGES 3
+#define PAGE_ROWS 32
+
+#define CHART_VRAM_ROW (NUM_PAGES * PAGE_ROWS)
+#define CHART_VRAM_ROWS 8
+
+// Each page's field page for interlaced output, in the unused columns beside it
+#define FIELD_PAGE_COL 64
+
+TilemapCtrl page_tile_ctrl[NUM_PAGES];
+uint16_t *page_vram[NUM_PAGES];
 uint16_t *vram_base = (uint16_t *)0x900000; // 128 * 128 = 16384 words
 uint16_t *vram = (uint16_t *)0x900000;
-uint8_t page_front = 0;
+uint8_t page_back = 0;
 uint16_t tile_w;
 uint16_t tile_h;
 
@@ -69,65 +99,127 @@ Context contexts[NUM_CTX];
 int context_idx = 0;
 Context *ctx = &contexts[0];
 
-void gfx_set_240p(float hz, bool wide)
+typedef struct
+{
+    uint16_t row;
+    uint16_t rows;
+    uint16_t col;
+    bool visible;
+} Chart;
+
+Chart chart;
+uint16_t mode_hofs;
+uint16_t mode_vbp;
+
+static void chart_update_ctrl();
+
+// Native and interlaced timings are twice the width of the 240p ones, and
+// native twice the height, with the tilemap doubling the pixels to match. So
+// the layout and the offsets below stay in 240p tile pixels.
+static void set_core_timing(const ModeTiming *timing, bool wide, CoreFormat format)
 {
-    VideoMode mode;
+    const VideoMode *mode = &timing->mode;
+    uint16_t hscale = format == CORE_240P ? 1 : 2;
+    uint16_t vscale = format == CORE_NATIVE ? 2 : 1;
 
-    if (wide)
-    {
-        mode.hact = 384;
-        mode.hfp = 16;
-        mode.hs = 32;
-        mode.hbp = 48;
-        mode.vact = 216;
-        mode.vfp = 3;
-        mode.vs = 5;
-        mode.vbp = 6;
-
-        contexts[0].rx = 0;
-        contexts[0].ry = 0;
-        contexts[0].rw = 48;
-        contexts[0].rh = 27;
-    }
-    else
+    crt_set_timing(timing, wide, format);
+    tile_ctrl->ctrl = (hscale == 2 ? TILEMAP_DOUBLE_H : 0) | (vscale == 2 ? TILEMAP_DOUBLE_V : 0);
+    tile_ctrl->field_hofs = 0;
+
+    contexts[0].rx = 0;
+    contexts[0].ry = 0;
+    contexts[0].rw = mode->hact / (8 * hscale);
+    contexts[0].rh = mode->vact / (8 * vscale);
+
+    mode_hofs = -((mode->hbp / hscale) - 9);
+    mode_vbp = mode->vbp / vscale;
+
+    for( int i = 0; i < NUM_PAGES; i++ )
     {
-        mode.hact = 320;
-        mode.hfp = 8;
-        mode.hs = 32;
-        mode.hbp = 40;
-        mode.vact = 240;
-        mode.vfp = 3;
-        mode.vs = 4;
-        mode.vbp = 6;
-
-        contexts[0].rx = 0;
-        contexts[0].ry = 0;
-        contexts[0].rw = 40;
-        contexts[0].rh = 30;
+        page_tile_ctrl[i].hofs = mode_hofs;
+        page_tile_ctrl[i].vofs = (i * PAGE_ROWS * 8) - mode_vbp;
+        page_vram[i] = vram_base + (TILE_MAX_W * PAGE_ROWS * i);
     }
 
-    uint32_t pixels = video_mode_pixels(&mode);
-    mode.mhz = (hz * pixels) / 1000000.0;
-    crt_set_mode(&mode, wide);
+    chart_update_ctrl();
 
-    page_tile_ctrl[0].hofs = -(mode.hs + mode.hfp- 9);
-    page_tile_ctrl[0].vofs = -mode.vbp;
-    page_vram[0] = vram_base;
+    gfx_pageflip();
+}
 
-    page_tile_ctrl[1].hofs = -(mode.hs + mode.hfp - 9);
-    page_tile_ctrl[1].vofs = (64 * 8) - mode.vbp;
-    page_vram[1] = vram_base + (TILE_MAX_W * 64);
+void gfx_set_240p(uint32_t millihz, bool wide)
+{
+    ModeTiming timing;
 
-    gfx_pageflip();
+    core_calc_mode(modes_core_refresh(millihz), wide, &timing);
+    set_core_timing(&timing, wide, CORE_240P);
+}
+
+void gfx_set_240p_preset(int refresh_idx, bool wide)
+{
+    set_core_timing(&core_mode_table[wide ? 1 : 0][refresh_idx], wide, CORE_240P);
+}
+
+void gfx_set_native_preset(int refresh_idx)
+{
+    set_core_timing(&core_native_table[refresh_idx], false, CORE_NATIVE);
+}
+
+void gfx_set_interlaced_preset(bool pal)
+{
+    set_core_timing(&core_interlaced_table[pal ? 1 : 0], false, pal ? CORE_576I : CORE_480I);
+}
+
+// The field pages are never drawn to, so they stay blank and the field that
+// shows them only shows the chart
+void gfx_set_field_pages(int field)
+{
+    uint16_t base_addr = (((uint32_t)vram_base) >> 1) & 0xffff;
+    blitter->addr = base_addr + FIELD_PAGE_COL;
+    blitter->value = 0x0020;
+    blitter->span = contexts[0].rw - 1;
+    blitter->repeat = (NUM_PAGES * PAGE_ROWS) - 1;
+    blitter->skip = TILE_MAX_W - (contexts[0].rw - 1);
+    blitter->submit = 1;
+
+    uint16_t page_hofs = mode_hofs;
+    uint16_t field_hofs = 0;
+
+    if (field == 0)
+    {
+        field_hofs = FIELD_PAGE_COL * 8;
+    }
+    else if (field == 1)
+    {
+        page_hofs = mode_hofs + (FIELD_PAGE_COL * 8);
+        field_hofs = -(FIELD_PAGE_COL * 8);
+    }
+
+    for( int i = 0; i < NUM_PAGES; i++ )
+    {
+        page_tile_ctrl[i].hofs = page_hofs;
+    }
+    tile_ctrl->field_hofs = field_hofs;
 }
 
+// Queue the back page for display and pick a new one to draw into. The queue
+// is committed by the tilemap at the start of vblank, so drawing never has to
+// wait for it. If a previously queued page was never shown it is replaced and
+// becomes the next back page.
 void gfx_pageflip()
 {
-    uint8_t page_back = page_front;
-    page_front = page_front ? 0 : 1;
+    uint8_t queued = page_back;
+
+    tile_ctrl->next_hofs = page_tile_ctrl[queued].hofs;
+    tile_ctrl->next_vofs = page_tile_ctrl[queued].vofs;
+    tile_ctrl->flip = queued;
+
+    uint8_t front = tile_ctrl->flip & FLIP_FRONT_MASK;
+
+    for( page_back = 0; page_back < NUM_PAGES; page_back++ )
+    {
+        if (page_back != queued && page_back != front) break;
+    }
 
-    tile_ctrl->hofs = page_tile_ctrl[page_front].hofs;
-    tile_ctrl->vofs = page_tile_ctrl[page_front].vofs;
     vram = page_vram[page_back];
 
     context_idx = 0;
@@ -152,7 +244,7 @@ void gfx_push()
     if (context_idx < NUM_CTX)
     {
         context_idx++;
-        memcpy(&contexts[context_idx], ctx, sizeof(Context));
+        contexts[context_idx] = *ctx;
         ctx = &contexts[context_idx];
     }
     else
@@ -485,6 +577,23 @@ void gfx_textf_aligned(Align align, const char *fmt, ...)
     gfx_text_aligned(align, tmp);
 }
 
+const char *gfx_text_cache(TextCache *cache, uint32_t key, const char *fmt, ...)
+{
+    if (!cache->valid || cache->key != key)
+    {
+        va_list args;
+
+        va_start(args, fmt);
+        vsnprintf(cache->text, sizeof(cache->text), fmt, args);
+        va_end(args);
+
+        cache->key = key;
+        cache->valid = true;
+    }
+
+    return cache->text;
+}
+
 void gfx_sameline()
 {
     ctx->sameline = true;
@@ -494,3 +603,98 @@ void gfx_newline(int n)
 {
     ctx->y += n;
 }
+
+// The chart lives in its own VRAM rows outside of the pages and is shown
+// through the tilemap scroll region. Each push writes a single column and
+// advances the region scroll, so nothing is ever redrawn. Pushes come from
+// the vblank interrupt, so the main loop masks it while it changes the chart.
+static void chart_update_ctrl()
+{
+    uint16_t sr = save_disable_interrupts();
+    uint16_t vstart = mode_vbp + (chart.row * 8);
+
+    tile_ctrl->region_vofs = (CHART_VRAM_ROW * 8) - vstart;
+    tile_ctrl->region_hofs = mode_hofs + ((chart.col - contexts[0].rw) * 8);
+    tile_ctrl->region_vstart = vstart;
+    tile_ctrl->region_vend = chart.visible ? vstart + (chart.rows * 8) : vstart;
+    restore_interrupts(sr);
+}
+
+void gfx_chart_init(uint16_t y, uint16_t rows)
+{
+    if (rows > CHART_VRAM_ROWS) rows = CHART_VRAM_ROWS;
+
+    uint16_t sr = save_disable_interrupts();
+
+    chart.row = ctx->ry + y;
+    chart.rows = rows;
+    chart.col = 0;
+
+    uint16_t base_addr = (((uint32_t)vram_base) >> 1) & 0xffff;
+    blitter->addr = base_addr + (CHART_VRAM_ROW * TILE_MAX_W);
+    blitter->value = 0x0020;
+    blitter->span = TILE_MAX_W - 1;
+    blitter->repeat = rows - 1;
+    blitter->skip = 1;
+    blitter->submit = 1;
+
+    chart_update_ctrl();
+    restore_interrupts(sr);
+}
+
+void gfx_chart_show(bool show)
+{
+    if (chart.visible == show) return;
+
+    chart.visible = show;
+    chart_update_ctrl();
+}
+
+void gfx_chart_push(uint16_t height, int color)
+{
+    uint16_t *col = vram_base + (CHART_VRAM_ROW + chart.rows - 1) * TILE_MAX_W + (chart.col & (TILE_MAX_W - 1));
+    uint16_t pen = color << 8;
+
+    for( uint16_t r = 0; r < chart.rows; r++ )
+    {
+        uint16_t fill = height > 8 ? 8 : height;
+        height -= fill;
+
+        if (fill == 0)
+            *col = pen | 0x20;
+        else if (fill < 3)
+            *col = pen | CHR_BOT;
+        else if (fill < 6)
+            *col = pen | CHR_LOWER_HALF;
+        else if (fill < 8)
+            *col = pen | (TEXT_INVERT << 8) | CHR_TOP;
+        else
+            *col = pen | (TEXT_INVERT << 8) | 0x20;
+
+        col -= TILE_MAX_W;
+    }
+
+    chart.col++;
+    tile_ctrl->region_hofs = mode_hofs + ((chart.col - contexts[0].rw) * 8);
+}
+
+void gfx_waveform(const uint8_t *columns, int count)
+{
+    char tmp[TILE_MAX_W + 1];
+
+    if (count > TILE_MAX_W) count = TILE_MAX_W;
+
+    for (int i = 0; i < count; i++)
+    {
+        switch (columns[i] & (WAVE_LOW | WAVE_HIGH))
+        {
+            case WAVE_LOW: tmp[i] = CHR_BOT; break;
+            case WAVE_HIGH: tmp[i] = CHR_TOP; break;
+            case WAVE_LOW | WAVE_HIGH: tmp[i] = CHR_VERT; break;
+            default: tmp[i] = ' '; break;
+        }
+    }
+    tmp[count] = '\0';
+
+    gfx_text(tmp);
+}
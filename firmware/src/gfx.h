@@ -24,7 +24,19 @@ typedef struct
 
 #define INIT_MENU_CONTEXT { .index = -1, .count = -1, .tmp_option_idx = -1 }
 
-void gfx_set_240p(float hz, bool wide);
+void gfx_set_240p(uint32_t millihz, bool wide);
+void gfx_set_240p_preset(int refresh_idx, bool wide);
+
+// Outputs core_native_mode with the same 320x240 layout, see modes.h
+void gfx_set_native_preset(int refresh_idx);
+
+// 480i, or 576i if 'pal', with each field showing the 320x240 layout
+void gfx_set_interlaced_preset(bool pal);
+
+// With an interlaced timing, shows the pages only in 'field' and leaves the
+// other field blank. A field of -1 shows them in both. Takes effect from the
+// next page flip.
+void gfx_set_field_pages(int field);
 
 void gfx_pageflip();
 
@@ -52,9 +64,29 @@ void gfx_frame(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 
 void gfx_display_border();
 
+void gfx_chart_init(uint16_t y, uint16_t rows);
+void gfx_chart_show(bool show);
+void gfx_chart_push(uint16_t height, int color);
+
+#define WAVE_LOW  0x01
+#define WAVE_HIGH 0x02
+
+// Draws one line of waveform, one character per column of WAVE_ flags
+void gfx_waveform(const uint8_t *columns, int count);
+
 #define gfx_text(x) gfx_text_aligned(ALIGN_LEFT, x);
 #define gfx_textf(x, ...) gfx_textf_aligned(ALIGN_LEFT, x, __VA_ARGS__);
 void gfx_textf_aligned(Align align, const char *fmt, ...);
+
+// Holds formatted text that is only re-rendered when its key changes
+typedef struct
+{
+    uint32_t key;
+    bool valid;
+    char text[40];
+} TextCache;
+
+const char *gfx_text_cache(TextCache *cache, uint32_t key, const char *fmt, ...);
 void gfx_text_aligned(Align align, const char *str);
 void gfx_sameline();
 void gfx_newline(int n);
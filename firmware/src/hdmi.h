@@ -1,28 +1,33 @@
 #if !defined(HDMI_H)
 #define HDMI_H 1
 
-typedef struct
-{
-	uint16_t hact;
-	uint16_t hfp;
-	uint16_t hs;
-	uint16_t hbp;
-	uint16_t vact;
-	uint16_t vfp;
-	uint16_t vs;
-	uint16_t vbp;
-
-    float mhz;
-} VideoMode;
-
-static inline uint32_t video_mode_pixels(const VideoMode *m)
-{
-    return ( m->hact + m->hbp + m->hfp + m->hs ) * ( m->vact + m->vbp + m->vfp + m->vs );
-}
-
-void hdmi_set_mode(uint16_t width, uint16_t height, float hz);
-
-void crt_set_mode(const VideoMode *mode, bool wide);
+#include "modecalc.h"
+#include "modes.h"
+
+void hdmi_set_timing(const ModeTiming *timing);
+// Returns false without changing the mode if it cannot be output
+bool hdmi_set_mode(uint16_t width, uint16_t height, uint32_t millihz);
+
+// Every format but CORE_240P has its tile pixels doubled by the tilemap
+void crt_set_timing(const ModeTiming *timing, bool wide, CoreFormat format);
+
+// Fine tunes the core pixel clock by reconfiguring only the fractional K of
+// the core PLL
+void crt_set_pll_k(uint32_t k);
+
+// Raises INT_SRC_LINE when the beam reaches pixel x of an active line. Negative
+// lines are in the vertical back porch. Both are in tile pixels. Nothing routes
+// INT_SRC_LINE yet; the stimulus is still written from the vblank handler.
+void crt_set_line_compare(int16_t line, int16_t x);
+
+// Field being output by an interlaced timing, 0 for the top field. Always 0
+// for progressive timings.
+int crt_field();
+
+// Adds 'lines' to the vertical front porch of the core timing from the next
+// frame, up to crt_max_vfp_extra(). crt_set_timing resets it to none.
+void crt_set_vfp_extra(uint16_t lines);
+uint16_t crt_max_vfp_extra();
 
 
 #endif // HDMI_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <stddef.h>
 
 #include "interrupts.h"
+#include "util.h"
 
 /* These are defined in the linker script */
 
@@ -20,22 +21,13 @@ int main(void);
 static void reset_handler(void)
 {
     /* Copy init values from text to data */
-    uint16_t *init_values_ptr = &_etext;
-    uint16_t *data_ptr = &_sdata;
-
-    if (init_values_ptr != data_ptr)
+    if (&_etext != &_sdata)
     {
-        for (; data_ptr < &_edata;)
-        {
-            *data_ptr++ = *init_values_ptr++;
-        }
+        memcpy(&_sdata, &_etext, (uint8_t *)&_edata - (uint8_t *)&_sdata);
     }
 
     /* Clear the zero segment */
-    for (uint16_t *bss_ptr = &_sbss; bss_ptr < &_ebss;)
-    {
-        *bss_ptr++ = 0;
-    }
+    memset(&_sbss, 0, (uint8_t *)&_ebss - (uint8_t *)&_sbss);
 
     /* Branch to main function */
     main();
@@ -1,6 +1,19 @@
 #include "input.h"
 
 static volatile uint16_t *gamepad_port = (volatile uint16_t *)0x400000;
+static volatile uint32_t *gamepad_ticks_port = (volatile uint32_t *)0x400004;
+
+typedef volatile struct
+{
+    uint16_t width[16];
+    struct
+    {
+        uint32_t rise;
+        uint32_t fall;
+    } edge[7];
+} InputFilter;
+
+static InputFilter *input_filter = (InputFilter *)0x310000;
 
 
 static uint16_t gamepad_prev = 0;
@@ -34,3 +47,34 @@ uint16_t input_released()
     return gamepad_released;
 }
 
+uint16_t input_gamepad_now()
+{
+    return *gamepad_port;
+}
+
+uint32_t input_gamepad_ticks()
+{
+    // Read a word at a time, so retry if a change lands in between
+    uint32_t ticks;
+    do
+    {
+        ticks = *gamepad_ticks_port;
+    } while (ticks != *gamepad_ticks_port);
+
+    return ticks;
+}
+
+void input_filter_width(int pin, uint16_t cycles)
+{
+    input_filter->width[pin] = cycles;
+}
+
+uint32_t input_rise_ticks(int pin)
+{
+    return input_filter->edge[pin].rise;
+}
+
+uint32_t input_fall_ticks(int pin)
+{
+    return input_filter->edge[pin].fall;
+}
@@ -16,4 +16,20 @@ uint16_t input_pressed();
 uint16_t input_released();
 uint16_t input_state();
 
+// Gamepad state read straight from the core, leaving input_pressed and
+// input_released alone, and the tick count of its latest change. Gamepad
+// changes are stamped when they reach the core from the HPS, after any USB
+// polling delay.
+uint16_t input_gamepad_now();
+uint32_t input_gamepad_ticks();
+
+// User port inputs pass through a hardware glitch filter. A pin only changes
+// once it has held a level for more than 'cycles' 50MHz cycles, and its edge
+// timestamps are those of the start of that level.
+#define INPUT_FILTER_HZ 50000000
+
+void input_filter_width(int pin, uint16_t cycles);
+uint32_t input_rise_ticks(int pin);
+uint32_t input_fall_ticks(int pin);
+
 #endif
\ No newline at end of file
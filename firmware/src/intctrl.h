@@ -0,0 +1,83 @@
+#if !defined( INTCTRL_H )
+#define INTCTRL_H 1
+
+#include <stdint.h>
+
+// Interrupt sources, one bit each in every register
+#define INT_SRC_VBLANK          (1 << 0)
+#define INT_SRC_ACTIVE          (1 << 1)  // inverse of VBLANK
+#define INT_SRC_HDMI_VBLANK     (1 << 2)
+#define INT_SRC_HDMI_ACTIVE     (1 << 3)  // inverse of HDMI_VBLANK
+#define INT_SRC_USER_IN(n)      (1 << (4 + (n)))
+#define INT_SRC_BLITTER         (1 << 11) // rises when a blit completes
+#define INT_SRC_TIMER0          (1 << 12)
+#define INT_SRC_LINE            (1 << 13) // crtc line compare, not routed yet
+#define INT_SRC_TIMER1          (1 << 14)
+#define INT_SRC_CAPTURE         (1 << 15) // rises when a sensor capture completes
+
+typedef volatile struct
+{
+    uint16_t enable;
+    uint16_t pending; // write 1 to acknowledge
+    uint16_t edge_rise;
+    uint16_t edge_fall;
+    uint16_t level2;
+    uint16_t level4;
+    uint16_t level6;
+    uint16_t status; // current level of each source
+} IntCtrl;
+
+#define INTCTRL ((IntCtrl *)0x700000)
+
+// Pending sources keep their level asserted, so every handler has to
+// acknowledge its sources before returning.
+static inline void intctrl_ack(uint16_t sources)
+{
+    INTCTRL->pending = sources;
+}
+
+// Routes sources to the three interrupt levels, each on its rising edge
+static inline void intctrl_route(uint16_t level2, uint16_t level4, uint16_t level6)
+{
+    IntCtrl *ic = INTCTRL;
+
+    ic->enable = 0;
+    ic->edge_rise = level2 | level4 | level6;
+    ic->edge_fall = 0;
+    ic->level2 = level2;
+    ic->level4 = level4;
+    ic->level6 = level6;
+    ic->pending = 0xffff;
+    ic->enable = level2 | level4 | level6;
+}
+
+// Pending sources, for handlers that serve more than one
+static inline uint16_t intctrl_pending()
+{
+    return INTCTRL->pending;
+}
+
+// Replaces the sources on level 6, leaving levels 2 and 4 and the falling
+// edges as they are. Only the sources taken off every level are acknowledged,
+// so an interrupt pending on the other levels is still served.
+static inline void intctrl_route_level6(uint16_t level6)
+{
+    IntCtrl *ic = INTCTRL;
+    uint16_t others = ic->level2 | ic->level4;
+    uint16_t removed = ic->level6 & ~level6 & ~others;
+
+    ic->enable = ic->enable & ~removed;
+    ic->level6 = level6;
+    ic->edge_rise = (ic->edge_rise & ~removed) | level6;
+    ic->pending = removed;
+    ic->enable = ic->enable | level6;
+}
+
+// Sources that also interrupt on their falling edge, until the next
+// intctrl_route
+static inline void intctrl_edge_fall(uint16_t sources)
+{
+    INTCTRL->edge_fall = sources;
+}
+
+#endif // INTCTRL_H
@@ -1,6 +1,8 @@
 #if !defined( INTERRUPTS_H )
 #define INTERRUPTS_H 1
 
+#include <stdint.h>
+
 __attribute__((interrupt)) void bus_error_handler();
 __attribute__((interrupt)) void address_error_handler();
 __attribute__((interrupt)) void illegal_instruction_handler();
@@ -40,4 +42,14 @@ __attribute__((interrupt)) void trap15_handler();
 static inline void enable_interrupts() { __asm__( "andi #0xf8ff, %sr" ); }
 static inline void disable_interrupts() { __asm__( "ori #0x0700, %sr" ); }
 
+// Safe to use from interrupt handlers, restores the previous mask rather than enabling everything
+static inline uint16_t save_disable_interrupts()
+{
+    uint16_t sr;
+    __asm__ volatile( "move.w %%sr, %0\n\tori #0x0700, %%sr" : "=d"(sr) : : "cc", "memory" );
+    return sr;
+}
+
+static inline void restore_interrupts(uint16_t sr) { __asm__ volatile( "move.w %0, %%sr" : : "d"(sr) : "cc", "memory" ); }
+
 #endif
\ No newline at end of file
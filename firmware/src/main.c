@@ -6,54 +6,111 @@
 #include "interrupts.h"
 #include "input.h"
 #include "hdmi.h"
+#include "modes.h"
 #include "gfx.h"
 #include "clock.h"
 #include "debug.h"
+#include "intctrl.h"
+#include "capture.h"
+#include "frametimer.h"
+#include "phaselock.h"
+#include "pacing.h"
+#include "avsync.h"
+#include "main.h"
+#include "flicker.h"
+#include "analogmode.h"
+#include "sweep.h"
+#include "refresh.h"
+#include "button.h"
+#include "avmode.h"
+#include "pacingmode.h"
 
 #define FIRMWARE_VERSION "1.3"
 
 #define RGB(r, g, b) ( ( ((r) & 0xf8) << 7 ) | ( ((g) & 0xf8) << 2 ) | ( ((b) & 0xf8) >> 3 ) )
 
-#define WAIT_CLEAR_TICKS CLOCK_MS_TO_TICKS(200)
-#define MIN_SAMPLE_TICKS CLOCK_MS_TO_TICKS(200)
-#define MAX_SAMPLE_TICKS CLOCK_MS_TO_TICKS(500)
-
 uint16_t *palette_ram = (uint16_t *)0x920000;
 volatile uint16_t *user_io = (volatile uint16_t *)0x300000;
-uint16_t *int_ctrl = (uint16_t *)0x700000;
 uint32_t *core_version = (uint32_t *)0xf00000;
 
-#define INT2_CTRL(x) (((x) & 0xf) << 0)
-#define INT4_CTRL(x) (((x) & 0xf) << 4)
-#define INT6_CTRL(x) (((x) & 0xf) << 8)
-#define INT_SRC_NONE 0
-#define INT_SRC_VBLANK 1
-#define INT_SRC_HDMI_VBLANK 2
-#define INT_SRC_USERIO 3
-#define INT_INVERT 0x8
-
-
 volatile uint32_t vblank_int_count = 0;
+volatile uint32_t vblank_int_ticks = 0;
 
 volatile uint16_t sample_seq = 0; 
 volatile uint16_t frame_seq = 0;
 volatile uint16_t sensor_seq = 0;
 
 volatile uint32_t frame_ticks = 0;
+
+// Video output whose active area starts the measurement
+volatile int frame_source = FRAME_SRC_CORE;
 volatile uint32_t sensor_ticks = 0;
 
+volatile bool sampling_active = false;
+void sampling_update();
+
+// Extra delay added by a PWM backlight to the sample with the matching sequence number
+volatile uint16_t gate_seq = 0;
+volatile uint32_t gate_ticks = 0;
 
 __attribute__((interrupt)) void level2_handler()
 {
+    intctrl_ack(INT_SRC_VBLANK);
+
     DEBUG_FRAME_MARKER(vblank_start);
+    vblank_int_ticks = clock_get_ticks();
     vblank_int_count++;
+
+    if (vrr_running)
+    {
+        vrr_frame();
+    }
+
+    if (analog_running)
+    {
+        analog_vblank();
+    }
+
+    if (button_running)
+    {
+        button_vblank();
+    }
+
+    if (avsync_running)
+    {
+        av_vblank();
+    }
+
+    if (pacing_running)
+    {
+        // The frame just shown started at the latest core active area
+        palette_ram[0x80] = pacing_vblank(frame_timer_last(FRAME_SRC_CORE)) ? 0xffff : 0x0000;
+    }
+
+    if (sampling_active)
+    {
+        sampling_update();
+    }
 }
 
+// Start of the active area of the measurement reference, HDMI or core
+volatile uint32_t active_int_count = 0;
+volatile uint32_t active_int_ticks = 0;
+volatile uint32_t active_int_period = 0;
+
 __attribute__((interrupt)) void level4_handler()
 {
+    intctrl_ack(INT_SRC_ACTIVE | INT_SRC_HDMI_ACTIVE);
+
+    uint32_t ticks = clock_get_ticks();
+    active_int_period = ticks - active_int_ticks;
+    active_int_ticks = ticks;
+    active_int_count++;
+
     if (frame_seq != sample_seq)
     {
-        frame_ticks = clock_get_ticks();
+        // Edge time from the frame timer, free of interrupt latency
+        frame_ticks = frame_timer_last(frame_source);
         frame_seq = sample_seq;
     }
 
@@ -62,11 +119,40 @@ __attribute__((interrupt)) void level4_handler()
 
 __attribute__((interrupt)) void level6_handler()
 {
+    uint16_t pending = intctrl_pending() & (INT_SRC_SENSOR | INT_SRC_BUTTON | INT_SRC_AUDIO | INT_SRC_TIMER0);
+    intctrl_ack(pending);
+
+    if (button_running)
+    {
+        button_poll(pending);
+    }
+
+    if (avsync_running)
+    {
+        if (pending & INT_SRC_SENSOR) avsync_video_edge(input_rise_ticks(SENSOR_PIN));
+        if (pending & INT_SRC_AUDIO) avsync_audio_edge(input_rise_ticks(AUDIO_PIN));
+    }
+
+    if (!(pending & INT_SRC_SENSOR))
+    {
+        return;
+    }
+
     if (sensor_seq != sample_seq)
     {
-        sensor_ticks = clock_get_ticks();
+        // Edge time from the filter, free of filter delay and interrupt latency
+        sensor_ticks = input_rise_ticks(SENSOR_PIN);
         sensor_seq = sample_seq;
     }
+
+    if (pacing_running)
+    {
+        // Whichever edge is newer is the one that raised the interrupt
+        uint32_t rise = input_rise_ticks(SENSOR_PIN);
+        uint32_t fall = input_fall_ticks(SENSOR_PIN);
+        bool light = (int32_t)(rise - fall) > 0;
+        pacing_edge(light ? rise : fall, light);
+    }
 }
 
 
@@ -93,17 +179,20 @@ typedef struct
 StatusInfo status;
 
 int test_position = 0;
-static inline Align align_test()
-{
-    return test_position == 0 ? ALIGN_LEFT : ALIGN_RIGHT;
-}
 
-static inline Align align_info()
-{
-    return test_position == 0 ? ALIGN_RIGHT : ALIGN_LEFT;
-}
+// With interlaced core video, the fields the test patch is shown in: both, top
+// only or bottom only. start_field is the field sampling starts in, or -1.
+int patch_field = 0;
+volatile int start_field = -1;
+
+typedef enum { MODE_NO_SENSOR, MODE_SAMPLING, MODE_MENU, MODE_FLICKER, MODE_ANALOG, MODE_SWEEP, MODE_REFRESH, MODE_PACING, MODE_BUTTON, MODE_AVSYNC } MainMode;
+
+// Mode to switch to when the menu closes
+MainMode menu_exit_mode = MODE_SAMPLING;
 
 char video_mode_desc[32];
+uint16_t video_mode_gen = 0;
+bool chart_reset = true;
 
 static void draw_status()
 {
@@ -118,53 +207,7 @@ static void draw_status()
     gfx_end_window();
 }
 
-typedef struct
-{
-    uint16_t width;
-    uint16_t height;
-    bool wide;
-} HDMIResolution;
-
-static const HDMIResolution hdmi_resolutions[] =
-{
-    {  640,  480, false },
-    {  800,  600, false },
-    { 1280,  720, true },
-    { 1024,  768, false },
-    { 1366,  768, false },
-    { 1280,  960, false },
-    { 1708,  960, true },
-    { 1920, 1080, true },
-    { 1600, 1200, false },
-    { 1792, 1344, false },
-    { 1920, 1440, false },
-    { 2048, 1536, false }
-};
-
-static const int hdmi_refresh_rates[] =
-{
-    24,
-    30,
-    50,
-    51,
-    52,
-    53,
-    54,
-    55,
-    56,
-    57,
-    58,
-    59,
-    60,
-    61,
-    62,
-    63,
-    64,
-    65,
-    72
-};
-
-static const char *resolution_to_string(const void *options, int index)
+const char *resolution_to_string(const void *options, int index)
 {
     static char tmp[32];
 
@@ -175,25 +218,285 @@ static const char *resolution_to_string(const void *options, int index)
     return tmp;
 }
 
-static const char *refresh_to_string(const void *options, int index)
+const char *refresh_to_string(const void *options, int index)
 {
-    static char tmp[10];
+    static char tmp[12];
 
-    const int *hz = (const int *)options;
+    const uint32_t *millihz = (const uint32_t *)options;
+    uint32_t hz = millihz[index] / 1000;
+    uint32_t frac = millihz[index] % 1000;
 
-    snprintf(tmp, sizeof(tmp), "%dhz", hz[index]);
+    if (frac == 0)
+        snprintf(tmp, sizeof(tmp), "%uhz", hz);
+    else if (frac % 10 == 0)
+        snprintf(tmp, sizeof(tmp), "%u.%02uhz", hz, frac / 10);
+    else
+        snprintf(tmp, sizeof(tmp), "%u.%03uhz", hz, frac);
 
     return tmp;
 }
 
+// After a mode change the display is given time to resync before sampling
+// resumes. The frame period of the measurement reference has to be steady and
+// close to the mode's nominal period, and the sensor has to see the dark patch
+// without any flashes, before sampling is armed again.
+#define SETTLE_PERIODS 8
+#define SETTLE_JITTER_TICKS (CLOCK_REF_MHZ * 50)
+#define SETTLE_DARK_TICKS CLOCK_MS_TO_TICKS(100)
+#define SETTLE_TIMEOUT_TICKS CLOCK_MS_TO_TICKS(10000)
+
+typedef struct
+{
+    bool active;
+    bool timed_out;
+    uint32_t start_ticks;
+    uint32_t expected_period; // zero when unknown
+
+    uint32_t last_count;
+    uint32_t last_period;
+    uint16_t stable;
+    uint32_t stable_ticks;    // start of the run of steady periods
+
+    bool dark;
+    uint32_t dark_ticks;      // start of the dark period
+
+    char desc[24];
+} Settle;
+
+static Settle settle;
+
+static void settle_begin(uint32_t expected_period)
+{
+    disable_interrupts();
+    settle.last_count = active_int_count;
+    enable_interrupts();
+
+    settle.active = true;
+    settle.timed_out = false;
+    settle.start_ticks = clock_get_ticks();
+    settle.expected_period = expected_period;
+    settle.last_period = 0;
+    settle.stable = 0;
+    settle.dark = false;
+
+    palette_ram[0x80] = 0x0000;
+}
+
+static inline uint32_t abs_diff(uint32_t a, uint32_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+bool settle_active()
+{
+    return settle.active;
+}
+
+// Called every frame, returns true when the display has just settled
+static bool settle_update()
+{
+    if (!settle.active) return false;
+
+    uint32_t now = clock_get_ticks();
+
+    disable_interrupts();
+    uint32_t count = active_int_count;
+    uint32_t ticks = active_int_ticks;
+    uint32_t period = active_int_period;
+    enable_interrupts();
+
+    if (count != settle.last_count)
+    {
+        bool steady = abs_diff(period, settle.last_period) <= SETTLE_JITTER_TICKS;
+        if (settle.expected_period)
+        {
+            steady = steady && (abs_diff(period, settle.expected_period) * 100) <= settle.expected_period;
+        }
+
+        if (!steady)
+            settle.stable = 0;
+        else if (settle.stable++ == 0)
+            settle.stable_ticks = ticks - period;
+
+        settle.last_count = count;
+        settle.last_period = period;
+    }
+
+    // Any light at all, even a filtered out flash, restarts the dark period
+    bool light = (*user_io & (1 << SENSOR_PIN)) != 0;
+    if (light || (settle.dark && (int32_t)(input_rise_ticks(SENSOR_PIN) - settle.dark_ticks) > 0))
+    {
+        settle.dark = false;
+    }
+    else if (!settle.dark)
+    {
+        settle.dark = true;
+        settle.dark_ticks = now;
+    }
+
+    if (settle.stable >= SETTLE_PERIODS && settle.dark && (now - settle.dark_ticks) >= SETTLE_DARK_TICKS)
+    {
+        char ms[CLOCK_MS_STR_LEN];
+        clock_ticks_to_ms_str(settle.stable_ticks - settle.start_ticks, ms);
+        snprintf(settle.desc, sizeof(settle.desc), "Resync: %s ms", ms);
+        settle.active = false;
+        return true;
+    }
+
+    if ((now - settle.start_ticks) >= SETTLE_TIMEOUT_TICKS)
+    {
+        strcpy(settle.desc, "Resync: timed out");
+        settle.active = false;
+        settle.timed_out = true;
+        return true;
+    }
+
+    return false;
+}
+
+// Core timing and refresh rate in use and HDMI frames per core frame, for the
+// phase lock and the diagnostics
+const ModeTiming *core_timing;
+uint32_t core_millihz;
+uint16_t core_hdmi_frames = 1;
+int phase_lock_on = 0;
+
+// -1 while the MiSTer default mode is in use
+static int applied_mode_idx = -1;
+int applied_refresh_idx = -1;
+static int applied_aspect_idx = -1;
+static int applied_core_idx = -1;
+static Blanking applied_blanking = { BLANKING_STANDARD, 0, 0 };
+
+const char *core_video_names[NUM_CORE_FORMATS] = { "240p", "Native", "480i", "576i" };
+const char *core_video_tags[NUM_CORE_FORMATS] = { "", "N", "480i", "576i" };
+static const char *patch_fields[3] = { "Both", "Top", "Bottom" };
+
+const char *blanking_names[NUM_BLANKING] = { "Standard", "CVT-RB v2", "Minimal" };
+const char *blanking_tags[NUM_BLANKING] = { "", "RB2", "Min" };
+
+// Options for the minimal blanking, in pixels and lines
+static const char *hblank_options[6] = { "48", "64", "80", "96", "128", "160" };
+static const uint16_t hblank_values[6] = { 48, 64, 80, 96, 128, 160 };
+static const char *vblank_options[7] = { "6", "8", "10", "15", "20", "30", "45" };
+static const uint16_t vblank_values[7] = { 6, 8, 10, 15, 20, 30, 45 };
+
+static bool blanking_equal(const Blanking *a, const Blanking *b)
+{
+    if (a->type != b->type) return false;
+    if (a->type != BLANKING_MINIMAL) return true;
+    return a->hblank == b->hblank && a->vblank == b->vblank;
+}
+
+// Standard blanking comes from the precomputed table, the others are checked
+// without the PLL search so this is cheap enough to call every frame
+bool video_mode_available(int mode_idx, int refresh_idx, const Blanking *blanking)
+{
+    if (blanking->type == BLANKING_STANDARD)
+        return mode_timing_valid(&hdmi_mode_table[mode_idx][refresh_idx]);
+
+    VideoMode mode;
+    return hdmi_calc_video_mode(hdmi_resolutions[mode_idx].width, hdmi_resolutions[mode_idx].height,
+                                hdmi_refresh_rates[refresh_idx], blanking, &mode);
+}
+
+bool core_format_available(int mode_idx, int core_idx)
+{
+    return core_idx != CORE_NATIVE || modes_native_available(mode_idx);
+}
+
+static bool core_format_interlaced(int core_idx)
+{
+    return core_idx == CORE_480I || core_idx == CORE_576I;
+}
+
+// Shows the test patch in the fields chosen by patch_field
+static void apply_patch_field()
+{
+    if (!core_format_interlaced(applied_core_idx))
+    {
+        gfx_set_field_pages(-1);
+        start_field = -1;
+        return;
+    }
+
+    gfx_set_field_pages(patch_field - 1);
+    start_field = patch_field - 1;
+}
+
+// core_idx selects the core timing, native only where the resolution allows
+// it. The interlaced formats run at their broadcast rate whatever the HDMI rate.
+void apply_video_mode(int mode_idx, int refresh_idx, int aspect_idx, int core_idx, const Blanking *blanking)
+{
+    if (!core_format_available(mode_idx, core_idx)) core_idx = CORE_240P;
+    bool wide = hdmi_resolutions[mode_idx].wide && (aspect_idx == 1) && core_idx == CORE_240P;
+    intctrl_route(INT_SRC_VBLANK, INT_SRC_HDMI_ACTIVE, INT_SRC_SENSOR);
+    frame_source = FRAME_SRC_HDMI;
+
+    // Locking restarts once the display has resynced
+    phase_lock_stop();
+    if (core_idx == CORE_NATIVE)
+    {
+        core_timing = &core_native_table[refresh_idx];
+        core_millihz = modes_native_refresh(hdmi_refresh_rates[refresh_idx]);
+        gfx_set_native_preset(refresh_idx);
+    }
+    else if (core_format_interlaced(core_idx))
+    {
+        bool pal = core_idx == CORE_576I;
+        core_timing = &core_interlaced_table[pal ? 1 : 0];
+        core_millihz = pal ? CORE_576I_MILLIHZ : CORE_480I_MILLIHZ;
+        gfx_set_interlaced_preset(pal);
+    }
+    else
+    {
+        core_timing = &core_mode_table[wide ? 1 : 0][refresh_idx];
+        core_millihz = modes_core_refresh(hdmi_refresh_rates[refresh_idx]);
+        gfx_set_240p_preset(refresh_idx, wide);
+    }
+    core_hdmi_frames = hdmi_refresh_rates[refresh_idx] / core_millihz;
+    if (core_hdmi_frames == 0) core_hdmi_frames = 1;
+    const ModeTiming *timing = &hdmi_mode_table[mode_idx][refresh_idx];
+    if (blanking->type != BLANKING_STANDARD)
+    {
+        static ModeTiming custom_timing;
+        hdmi_calc_mode_blanking(hdmi_resolutions[mode_idx].width, hdmi_resolutions[mode_idx].height,
+                                hdmi_refresh_rates[refresh_idx], blanking, &custom_timing);
+        timing = &custom_timing;
+    }
+    hdmi_set_timing(timing);
+    settle_begin(((uint64_t)video_mode_pixels(&timing->mode) * CLOCK_REF_KHZ) / timing->mode.khz);
+    applied_mode_idx = mode_idx;
+    applied_refresh_idx = refresh_idx;
+    applied_aspect_idx = aspect_idx;
+    applied_core_idx = core_idx;
+    applied_blanking = *blanking;
+    chart_reset = true;
+    apply_patch_field();
+
+    snprintf(video_mode_desc, sizeof(video_mode_desc), "%s @ %s%s%s%s%s",
+                resolution_to_string(hdmi_resolutions, mode_idx),
+                refresh_to_string(hdmi_refresh_rates, refresh_idx),
+                blanking->type == BLANKING_STANDARD ? "" : " ",
+                blanking_tags[blanking->type],
+                core_idx == CORE_240P ? "" : " ",
+                core_video_tags[core_idx]);
+    video_mode_gen++;
+}
+
+static const char *tool_names[] = { "Flicker Analysis", "Analog Response", "Mode Sweep", "Refresh Diagnostics", "Frame Pacing", "Button to Photon", "Audio Video Sync" };
+static const MainMode tool_modes[] = { MODE_FLICKER, MODE_ANALOG, MODE_SWEEP, MODE_REFRESH, MODE_PACING, MODE_BUTTON, MODE_AVSYNC };
+static int tool_idx = 0;
+
 static bool draw_menu(bool reset)
 {
     static int mode_idx = 0;
     static int refresh_idx = 0;
     static int aspect_idx = 0;
-    static int applied_mode_idx = -1;
-    static int applied_refresh_idx = -1;
-    static int applied_aspect_idx = -1;
+    static int core_idx = 0;
+    static int blanking_idx = 0;
+    static int hblank_idx = 0;
+    static int vblank_idx = 0;
 
     static MenuContext menuctx = INIT_MENU_CONTEXT;
 
@@ -206,23 +509,34 @@ static bool draw_menu(bool reset)
             mode_idx = applied_mode_idx;
             refresh_idx = applied_refresh_idx;
             aspect_idx = applied_aspect_idx;
+            core_idx = applied_core_idx;
+            blanking_idx = applied_blanking.type;
         }
         else
         {
             mode_idx = 7;
-            refresh_idx = 12;
+            refresh_idx = modes_find_refresh(60000);
             aspect_idx = 0;
         }
     }
 
     gfx_clear();
 
-    gfx_begin_menu("CONFIG", 28, 18, &menuctx);
+    gfx_begin_menu("CONFIG", 28, 29, &menuctx);
     
     gfx_menuitem_select_func("Resolution", hdmi_resolutions, ARRAY_COUNT(hdmi_resolutions), resolution_to_string, &mode_idx);
     gfx_menuitem_select_func("Refresh Rate", hdmi_refresh_rates, ARRAY_COUNT(hdmi_refresh_rates), refresh_to_string, &refresh_idx);
 
-    if (hdmi_resolutions[mode_idx].wide)
+    gfx_menuitem_select("Core Video", core_video_names, NUM_CORE_FORMATS, &core_idx);
+    if (core_format_interlaced(core_idx))
+    {
+        // Applies straight away when the interlaced format is already in use
+        if (gfx_menuitem_select("Patch Field", patch_fields, 3, &patch_field) && core_idx == applied_core_idx)
+        {
+            apply_patch_field();
+        }
+    }
+    else if (core_idx == CORE_240P && hdmi_resolutions[mode_idx].wide)
     {
         const char *aspects[2] = { "4:3", "16:9" };
         gfx_menuitem_select("Aspect Ratio", aspects, 2, &aspect_idx);
@@ -232,24 +546,34 @@ static bool draw_menu(bool reset)
         gfx_newline(2);
     }
 
+    gfx_menuitem_select("Blanking", blanking_names, NUM_BLANKING, &blanking_idx);
+    if (blanking_idx == BLANKING_MINIMAL)
+    {
+        gfx_menuitem_select("H Blank Pixels", hblank_options, ARRAY_COUNT(hblank_options), &hblank_idx);
+        gfx_menuitem_select("V Blank Lines", vblank_options, ARRAY_COUNT(vblank_options), &vblank_idx);
+    }
+    else
+    {
+        gfx_newline(2);
+    }
+
+    Blanking blanking = { blanking_idx, hblank_values[hblank_idx], vblank_values[vblank_idx] };
+
     gfx_newline(1);
 
-    if (mode_idx != applied_mode_idx || refresh_idx != applied_refresh_idx || aspect_idx != applied_aspect_idx)
+    if (!video_mode_available(mode_idx, refresh_idx, &blanking) || !core_format_available(mode_idx, core_idx))
+    {
+        gfx_newline(1);
+        gfx_pen(TEXT_DARK_GRAY);
+        gfx_text_aligned(ALIGN_CENTER, "Mode Unavailable");
+    }
+    else if (mode_idx != applied_mode_idx || refresh_idx != applied_refresh_idx || aspect_idx != applied_aspect_idx
+                || core_idx != applied_core_idx || !blanking_equal(&blanking, &applied_blanking))
     {
         if (gfx_menuitem_button("Apply Video Changes"))
         {
-            bool wide = hdmi_resolutions[mode_idx].wide && (aspect_idx == 1);
-            *int_ctrl = INT2_CTRL(INT_SRC_VBLANK) | INT4_CTRL(INT_SRC_HDMI_VBLANK | INT_INVERT) | INT6_CTRL(INT_SRC_USERIO);
-            gfx_set_240p(hdmi_refresh_rates[refresh_idx], wide);
-            hdmi_set_mode(hdmi_resolutions[mode_idx].width, hdmi_resolutions[mode_idx].height, hdmi_refresh_rates[refresh_idx]);
-            applied_mode_idx = mode_idx;
-            applied_refresh_idx = refresh_idx;
-            applied_aspect_idx = aspect_idx;
+            apply_video_mode(mode_idx, refresh_idx, aspect_idx, core_idx, &blanking);
             close_menu = true;
-
-            snprintf(video_mode_desc, sizeof(video_mode_desc), "%s @ %s",
-                        resolution_to_string(hdmi_resolutions, mode_idx),
-                        refresh_to_string(hdmi_refresh_rates, refresh_idx));
         }
     }
 
@@ -257,6 +581,28 @@ static bool draw_menu(bool reset)
     const char *test_positions[2] = { "Left", "Right" };
     gfx_menuitem_select("Test Position", test_positions, 2, &test_position);
 
+    const char *off_on[2] = { "Off", "On" };
+    if (gfx_menuitem_select("Phase Lock", off_on, 2, &phase_lock_on) && !settle.active)
+    {
+        if (phase_lock_on)
+            phase_lock_start(core_timing, core_hdmi_frames);
+        else
+            phase_lock_stop();
+    }
+
+    // The tools share one selector, the menu has no room for a button each
+    gfx_newline(1);
+    gfx_menuitem_select("Tool", tool_names, ARRAY_COUNT(tool_names), &tool_idx);
+    if (gfx_menuitem_button("Open Tool"))
+    {
+        if (tool_modes[tool_idx] == MODE_SWEEP)
+        {
+            sweep_select(mode_idx, refresh_idx, aspect_idx, core_idx, &blanking);
+        }
+        menu_exit_mode = tool_modes[tool_idx];
+        close_menu = true;
+    }
+
     gfx_end_menu();
 
     if (input_pressed() & (INPUT_MENU | INPUT_BACK))
@@ -275,29 +621,76 @@ void wait_vblank()
     vblank_count = vblank_int_count;
 }
 
-typedef enum
-{
-    ST_CLEAR = 0,
-    ST_WAIT_CLEAR,
-    ST_START_SAMPLE,
-    ST_WAIT_SAMPLE,
-    ST_END_SAMPLE,
-} State;
-
 State state = ST_CLEAR;
 uint32_t state_start_ticks;
 
-static void set_state(State s)
+void set_state(State s)
 {
     state = s;
     state_start_ticks = clock_get_ticks();
 }
 
-int ticks_to_ms_str(uint32_t ticks, char *str, int len)
+// Builds "<label><ms> ms" without going through printf
+static void format_ms_line(char *line, const char *label, uint32_t ticks)
 {
-    uint32_t ms, us;
-    clock_ticks_to_ms_us(ticks, &ms, &us);
-    return snprintf(str, len, "%u.%03u", ms, us);
+    char tmp[8 + CLOCK_MS_STR_LEN + 3];
+    char *p = tmp;
+
+    while (*label) *p++ = *label++;
+    p = clock_ticks_to_ms_str(ticks, p);
+    strcpy(p, " ms");
+
+    tmp[STATUS_W - 1] = '\0';
+    strcpy(line, tmp);
+}
+
+#define CHART_ROWS 3
+#define CHART_TICKS_PER_PIXEL CLOCK_MS_TO_TICKS(1)
+
+uint32_t chart_base_ticks;
+
+static void chart_sample(uint32_t ticks)
+{
+    const uint32_t chart_h = CHART_ROWS * 8;
+
+    if (chart_base_ticks == 0)
+    {
+        uint32_t half_range = (chart_h / 2) * CHART_TICKS_PER_PIXEL;
+        chart_base_ticks = ticks > half_range ? ticks - half_range : 1;
+    }
+
+    if (ticks < chart_base_ticks)
+    {
+        gfx_chart_push(1, TEXT_BLUE);
+        return;
+    }
+
+    uint32_t h = ( ticks - chart_base_ticks ) / CHART_TICKS_PER_PIXEL;
+
+    if (h >= chart_h)
+        gfx_chart_push(chart_h, TEXT_RED);
+    else
+        gfx_chart_push(h + 1, TEXT_GREEN);
+}
+
+LatencyStats * volatile sample_stats = NULL;
+
+void latency_stats_add(LatencyStats *r, uint32_t ticks)
+{
+    if (r->count == 0 || ticks < r->min_ticks) r->min_ticks = ticks;
+    if (r->count == 0 || ticks > r->max_ticks) r->max_ticks = ticks;
+    r->total_ticks += ticks;
+    r->count++;
+}
+
+void stats_to_ms(const LatencyStats *s, char *avg, char *min, char *max)
+{
+    clock_ticks_to_ms_str(s->total_ticks / s->count, avg);
+    clock_ticks_to_ms_str(s->min_ticks, min);
+    clock_ticks_to_ms_str(s->max_ticks, max);
+    avg[strlen(avg) - 1] = '\0';
+    min[strlen(min) - 1] = '\0';
+    max[strlen(max) - 1] = '\0';
 }
 
 #define HISTORY_SIZE 16
@@ -311,7 +704,7 @@ typedef enum
     MISSING_SAMPLE
 } SampleStatus;
 
-SampleStatus sample_status;
+volatile SampleStatus sample_status;
 
 void record_new_sample(uint32_t ticks)
 {
@@ -319,11 +712,19 @@ void record_new_sample(uint32_t ticks)
     samples[sample_idx % HISTORY_SIZE] = ticks;
     sample_idx++;
     sample_status = NEW_SAMPLE;
+    chart_sample(ticks);
+
+    LatencyStats *r = sample_stats;
+    if (r) latency_stats_add(r, ticks);
 }
 
 void record_missing_sample()
 {
     sample_status = MISSING_SAMPLE;
+    gfx_chart_push(CHART_ROWS * 8, TEXT_DARK_ORANGE);
+
+    LatencyStats *r = sample_stats;
+    if (r) r->missing++;
 }
 
 void update_sample_status()
@@ -350,24 +751,14 @@ void update_sample_status()
     status.colors[2] = TEXT_GRAY;
     status.colors[3] = TEXT_GRAY;
 
-    char ms_str1[16], ms_str2[16];
-    ticks_to_ms_str(latest_sample, ms_str1, 16);
-    ticks_to_ms_str(mean_ticks, ms_str2, 16);
-    snprintf(status.lines[0], STATUS_W, "Cur: %s ms", ms_str1);
-    snprintf(status.lines[1], STATUS_W, "Avg: %s ms", ms_str2);
-
-    ticks_to_ms_str(min_ticks, ms_str1, 16);
-    ticks_to_ms_str(max_ticks, ms_str2, 16);
-    snprintf(status.lines[2], STATUS_W, "Min: %s ms", ms_str1);
-    snprintf(status.lines[3], STATUS_W, "Max: %s ms", ms_str2);
+    format_ms_line(status.lines[0], "Cur: ", latest_sample);
+    format_ms_line(status.lines[1], "Avg: ", mean_ticks);
+    format_ms_line(status.lines[2], "Min: ", min_ticks);
+    format_ms_line(status.lines[3], "Max: ", max_ticks);
 }
 
-typedef enum { MODE_NO_SENSOR, MODE_SAMPLING, MODE_MENU } MainMode;
-
-#define BAR_W 11
-#define BAR_H 4
-
-void do_sampling()
+// Runs from the vblank interrupt so the stimulus and sampling never wait on drawing
+void sampling_update()
 {
     uint32_t cur_ticks = clock_get_ticks();
     uint32_t state_ticks = cur_ticks - state_start_ticks;
@@ -387,7 +778,21 @@ void do_sampling()
             break;
 
         case ST_START_SAMPLE:
+            // The field changes after this vblank, so wait while the field
+            // ending is the one the patch should start in
+            if (crt_field() == start_field)
+            {
+                break;
+            }
+
+            // A VRR sweep files the sample under the frame time before the patch
+            if (vrr_running)
+            {
+                sample_stats = vrr_frame_stats();
+            }
+
             set_state(ST_WAIT_SAMPLE);
+            capture_arm();
             palette_ram[0x80] = 0xffff;
             sample_seq++;
             DEBUG_FRAME_MARKER(sample_start);
@@ -399,12 +804,19 @@ void do_sampling()
                 break;
             }
 
-            if (state_ticks > MAX_SAMPLE_TICKS)
+            bool seen = sample_seq == frame_seq && sample_seq == sensor_seq;
+
+            // The main loop decodes the PWM gate from the finished capture.
+            // Wait for it so a slow frame does not skip the correction, but
+            // only until the timeout.
+            bool gate_ready = gate_seq == sample_seq || !capture_done();
+
+            if (state_ticks > MAX_SAMPLE_TICKS && !seen)
             {
                 set_state(ST_CLEAR);
                 record_missing_sample();
             }
-            else if (sample_seq == frame_seq && sample_seq == sensor_seq)
+            else if (seen && (gate_ready || state_ticks > MAX_SAMPLE_TICKS))
             {
                 set_state(ST_CLEAR);
                 if (frame_ticks >= sensor_ticks)
@@ -414,6 +826,10 @@ void do_sampling()
                 else
                 {
                     uint32_t tick_diff = sensor_ticks - frame_ticks;
+                    if (gate_seq == sample_seq && gate_ticks < tick_diff)
+                    {
+                        tick_diff -= gate_ticks;
+                    }
                     record_new_sample(tick_diff);
                 }
             }
@@ -423,8 +839,72 @@ void do_sampling()
             set_state(ST_CLEAR);
             break;
     }
+}
 
+#define WAVE_W 24
 
+static uint8_t wave_columns[WAVE_W];
+static char wave_desc[WAVE_W + 1];
+static bool wave_valid = false;
+static uint32_t wave_trigger_ticks;
+
+// Decodes a finished capture once, the capture stays done until the next sample arms it
+static void update_waveform()
+{
+    if (!capture_done()) return;
+
+    uint32_t trigger_ticks = capture_trigger_ticks();
+    if (wave_valid && trigger_ticks == wave_trigger_ticks) return;
+
+    CapturePWM pwm;
+    uint32_t delay_ticks = 0;
+    capture_waveform(wave_columns, WAVE_W);
+    if (capture_pwm(&pwm))
+    {
+        delay_ticks = capture_samples_to_ticks(capture_gated_delay(&pwm));
+        snprintf(wave_desc, sizeof(wave_desc), "PWM %uHz %u.%u%%%s", pwm.freq_hz,
+                    pwm.duty_permille / 10, pwm.duty_permille % 10, delay_ticks ? " ADJ" : "");
+    }
+    else
+    {
+        strcpy(wave_desc, "No PWM");
+    }
+
+    // Still within the same sample unless the next one has armed the capture
+    // since it was read, which clears done
+    disable_interrupts();
+    if (capture_done() && capture_trigger_ticks() == trigger_ticks)
+    {
+        gate_ticks = delay_ticks;
+        gate_seq = sample_seq;
+    }
+    enable_interrupts();
+
+    wave_trigger_ticks = trigger_ticks;
+    wave_valid = true;
+}
+
+void waveform_reset()
+{
+    wave_valid = false;
+}
+
+static void draw_waveform()
+{
+    update_waveform();
+
+    if (!wave_valid) return;
+
+    gfx_begin_window(ALIGN_TOP | align_info(), 2, 7, WAVE_W, 2, 0);
+    gfx_pen(TEXT_CYAN);
+    gfx_waveform(wave_columns, WAVE_W);
+    gfx_pen(TEXT_GRAY);
+    gfx_text(wave_desc);
+    gfx_end_window();
+}
+
+void draw_sampling()
+{
     gfx_clear();
     gfx_pen(TEXT_DARK_GRAY);
     gfx_display_border();
@@ -438,6 +918,14 @@ void do_sampling()
     gfx_align_box(align_test() | ALIGN_MIDDLE, 0, 0, BAR_W, BAR_H, &rx, &ry);
     gfx_rect(rx, ry, BAR_W, BAR_H);
 
+    if (chart_reset)
+    {
+        gfx_chart_init(ry + BAR_H, CHART_ROWS);
+        chart_base_ticks = 0;
+        chart_reset = false;
+    }
+    gfx_chart_show(true);
+
     gfx_align_box(align_test() | ALIGN_BOTTOM, 0, 0, BAR_W, BAR_H, &rx, &ry);
     gfx_rect(rx, ry, BAR_W, BAR_H);
 
@@ -447,20 +935,29 @@ void do_sampling()
     else
         gfx_image(0x80, 0x40, rx, ry, 4, 4);
 
-    gfx_begin_window(ALIGN_BOTTOM | align_info(), 2, 5, 24, 2, 0);
+    gfx_begin_window(ALIGN_BOTTOM | align_info(), 2, 5, 26, 3, 0);
     gfx_pen(TEXT_BLUE);
-    gfx_textf("Mode: %s", video_mode_desc);
+    static TextCache mode_text;
+    gfx_text(gfx_text_cache(&mode_text, video_mode_gen, "Mode: %s", video_mode_desc));
+    gfx_pen(settle.timed_out ? TEXT_ORANGE : TEXT_GRAY);
+    gfx_text(settle.active ? "Resyncing..." : settle.desc);
     gfx_pen(TEXT_DARK_BLUE);
     gfx_text("Press START for menu.");
     gfx_end_window();
 
     draw_status();
+    draw_waveform();
 
-    switch (sample_status)
+    disable_interrupts();
+    SampleStatus new_status = sample_status;
+    sample_status = NO_SAMPLE;
+    enable_interrupts();
+
+    switch (new_status)
     {
         case MISSING_SAMPLE:
             status.colors[0] = TEXT_ORANGE;
-            snprintf(status.lines[0], STATUS_W, "CUR: NO SAMPLE");
+            strcpy(status.lines[0], "CUR: NO SAMPLE");
             break;
 
         case NEW_SAMPLE:
@@ -471,8 +968,23 @@ void do_sampling()
         default:
             break;
     }
+}
 
-    sample_status = NO_SAMPLE;
+void draw_test_bars()
+{
+    gfx_clear();
+    gfx_pen(TEXT_DARK_GRAY);
+    gfx_display_border();
+
+    gfx_pen(0x80);
+
+    int16_t rx, ry;
+    gfx_align_box(align_test() | ALIGN_TOP, 0, 0, BAR_W, BAR_H, &rx, &ry);
+    gfx_rect(rx, ry, BAR_W, BAR_H);
+    gfx_align_box(align_test() | ALIGN_MIDDLE, 0, 0, BAR_W, BAR_H, &rx, &ry);
+    gfx_rect(rx, ry, BAR_W, BAR_H);
+    gfx_align_box(align_test() | ALIGN_BOTTOM, 0, 0, BAR_W, BAR_H, &rx, &ry);
+    gfx_rect(rx, ry, BAR_W, BAR_H);
 }
 
 void draw_no_sensor()
@@ -494,7 +1006,9 @@ void draw_version()
 {
     gfx_pen(TEXT_DARK);
     gfx_begin_window(ALIGN_BOTTOM | align_info(), 2, 2, 24, 1, 0);
-    gfx_textf_aligned(ALIGN_LEFT, "MiSTer Laggy %s/%06u", FIRMWARE_VERSION, *core_version);
+    static TextCache version_text;
+    uint32_t version = *core_version;
+    gfx_text(gfx_text_cache(&version_text, version, "MiSTer Laggy %s/%06u", FIRMWARE_VERSION, version));
     gfx_end_window();
 }
 
@@ -550,13 +1064,17 @@ int main(int argc, char *argv[])
     strcpy(video_mode_desc, "MiSTer Default");
 
     set_palette();
+    capture_config(CAPTURE_DEFAULT_DIV, CAPTURE_DEFAULT_DURATION);
 
     *user_io = 0xffff;
-    *int_ctrl = INT2_CTRL(INT_SRC_VBLANK) | INT4_CTRL(INT_SRC_VBLANK | INT_INVERT) | INT6_CTRL(INT_SRC_USERIO);
+    input_filter_width(SENSOR_PIN, SENSOR_FILTER_CYCLES);
+    intctrl_route(INT_SRC_VBLANK, INT_SRC_ACTIVE, INT_SRC_SENSOR);
 
     memset(&status, 0, sizeof(status));
 
-    gfx_set_240p(60, false);
+    core_timing = &core_mode_table[0][modes_find_refresh(60000)];
+    core_millihz = modes_core_refresh(60000);
+    gfx_set_240p_preset(modes_find_refresh(60000), false);
 
     enable_interrupts();
 
@@ -564,14 +1082,31 @@ int main(int argc, char *argv[])
 
     while (true)
     {
+        // Paces the UI to the refresh rate, drawing can overrun without affecting sampling
         wait_vblank();
-        gfx_pageflip();
         input_poll();
 
+        if (settle_update())
+        {
+            // Start from a clean cycle, whatever state the mode change interrupted
+            set_state(ST_CLEAR);
+
+            if (phase_lock_on) phase_lock_start(core_timing, core_hdmi_frames);
+        }
+
+        phase_lock_update();
+
+        sampling_active = !settle.active && (mode == MODE_SAMPLING || (mode == MODE_SWEEP && sweep_phase() == SWEEP_SAMPLE));
+
+        if (mode != MODE_SAMPLING && !(mode == MODE_SWEEP && (sweep_phase() == SWEEP_SETTLE || sweep_phase() == SWEEP_SAMPLE)))
+        {
+            gfx_chart_show(false);
+        }
+
         if (mode == MODE_SAMPLING)
         {
             new_mode = false;
-            do_sampling();
+            draw_sampling();
             if (input_pressed() & INPUT_MENU)
             {
                 mode = MODE_MENU;
@@ -588,7 +1123,8 @@ int main(int argc, char *argv[])
         {
             if( !draw_menu(new_mode) )
             {
-                mode = MODE_SAMPLING;
+                mode = menu_exit_mode;
+                menu_exit_mode = MODE_SAMPLING;
                 new_mode = true;
             }
             else
@@ -596,6 +1132,118 @@ int main(int argc, char *argv[])
                 new_mode = false;
             }
         }
+        else if (mode == MODE_FLICKER)
+        {
+            if (new_mode)
+            {
+                flicker_start();
+                new_mode = false;
+            }
+
+            draw_flicker();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                flicker_stop();
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_ANALOG)
+        {
+            if (new_mode)
+            {
+                analog_start();
+                new_mode = false;
+            }
+
+            draw_analog();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                analog_stop();
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_SWEEP)
+        {
+            bool reset = new_mode;
+            new_mode = false;
+
+            if (!draw_sweep(reset))
+            {
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_REFRESH)
+        {
+            if (new_mode)
+            {
+                refresh_diag_start();
+                new_mode = false;
+            }
+
+            draw_refresh();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_PACING)
+        {
+            if (new_mode)
+            {
+                pacing_start();
+                new_mode = false;
+            }
+
+            draw_pacing();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                pacing_stop();
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_BUTTON)
+        {
+            if (new_mode)
+            {
+                button_start();
+                new_mode = false;
+            }
+
+            draw_button();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                button_stop();
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
+        else if (mode == MODE_AVSYNC)
+        {
+            if (new_mode)
+            {
+                av_start();
+                new_mode = false;
+            }
+
+            draw_av();
+
+            if (input_pressed() & (INPUT_BACK | INPUT_MENU))
+            {
+                av_stop();
+                mode = MODE_SAMPLING;
+                new_mode = true;
+            }
+        }
         else if (mode == MODE_NO_SENSOR)
         {
             if (!(*user_io & 0x0001))
@@ -612,6 +1260,8 @@ int main(int argc, char *argv[])
 
         DEBUG_FRAME_MARKER(frontend_end);
         DEBUG_END_FRAME();
+
+        gfx_pageflip();
     }
 
     return 0;
@@ -0,0 +1,126 @@
+#if !defined( MAIN_H )
+#define MAIN_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gfx.h"
+#include "input.h"
+#include "intctrl.h"
+#include "clock.h"
+#include "modes.h"
+
+// What main.c shares with the tool screens: the sampling cycle, the video
+// mode in use and the layout of the test screen. Each tool lives in its own
+// file and is started, drawn and stopped from the main loop.
+
+#define WAIT_CLEAR_TICKS CLOCK_MS_TO_TICKS(200)
+#define MIN_SAMPLE_TICKS CLOCK_MS_TO_TICKS(200)
+#define MAX_SAMPLE_TICKS CLOCK_MS_TO_TICKS(500)
+
+#define SENSOR_PIN 1
+#define INT_SRC_SENSOR INT_SRC_USER_IN(SENSOR_PIN)
+
+// Sensor pulses shorter than 1us are treated as noise
+#define SENSOR_FILTER_CYCLES (INPUT_FILTER_HZ / 1000000)
+
+// A switch for button to photon pulls this pin low
+#define BUTTON_PIN 2
+#define INT_SRC_BUTTON INT_SRC_USER_IN(BUTTON_PIN)
+
+// An audio detector for audio video sync drives this pin high on sound
+#define AUDIO_PIN 3
+#define INT_SRC_AUDIO INT_SRC_USER_IN(AUDIO_PIN)
+
+// Size of the test patch bars, in 8 pixel cells
+#define BAR_W 11
+#define BAR_H 4
+
+extern uint16_t *palette_ram;
+extern volatile uint16_t *user_io;
+
+extern volatile uint32_t vblank_int_count;
+extern volatile uint32_t vblank_int_ticks;
+
+extern volatile uint16_t sample_seq;
+extern volatile uint16_t sensor_seq;
+extern volatile uint32_t sensor_ticks;
+
+typedef enum
+{
+    ST_CLEAR = 0,
+    ST_WAIT_CLEAR,
+    ST_START_SAMPLE,
+    ST_WAIT_SAMPLE,
+    ST_END_SAMPLE,
+} State;
+
+void set_state(State s);
+
+// Latency statistics over a set of samples
+typedef struct
+{
+    uint16_t count;
+    uint16_t missing;
+    uint32_t min_ticks;
+    uint32_t max_ticks;
+    uint32_t total_ticks;
+} LatencyStats;
+
+// Samples are also added here while a sweep is collecting them
+extern LatencyStats * volatile sample_stats;
+
+void latency_stats_add(LatencyStats *r, uint32_t ticks);
+
+// Average, minimum and maximum in ms, shown to 10us so a results row fits
+void stats_to_ms(const LatencyStats *s, char *avg, char *min, char *max);
+
+// Core timing and refresh rate in use and HDMI frames per core frame
+extern const ModeTiming *core_timing;
+extern uint32_t core_millihz;
+extern uint16_t core_hdmi_frames;
+extern int phase_lock_on;
+
+// -1 while the MiSTer default mode is in use
+extern int applied_refresh_idx;
+
+extern char video_mode_desc[32];
+
+extern const char *core_video_names[NUM_CORE_FORMATS];
+extern const char *core_video_tags[NUM_CORE_FORMATS];
+extern const char *blanking_names[NUM_BLANKING];
+extern const char *blanking_tags[NUM_BLANKING];
+
+const char *resolution_to_string(const void *options, int index);
+const char *refresh_to_string(const void *options, int index);
+
+bool video_mode_available(int mode_idx, int refresh_idx, const Blanking *blanking);
+bool core_format_available(int mode_idx, int core_idx);
+void apply_video_mode(int mode_idx, int refresh_idx, int aspect_idx, int core_idx, const Blanking *blanking);
+
+// True while the display resyncs after a mode change
+bool settle_active();
+
+extern int test_position;
+
+static inline Align align_test()
+{
+    return test_position == 0 ? ALIGN_LEFT : ALIGN_RIGHT;
+}
+
+static inline Align align_info()
+{
+    return test_position == 0 ? ALIGN_RIGHT : ALIGN_LEFT;
+}
+
+// Clears the screen and draws the border and the three test patch bars
+void draw_test_bars();
+
+void draw_sampling();
+
+// Drops the decoded sensor waveform, for tools that reconfigure the capture
+void waveform_reset();
+
+uint32_t rand32();
+
+#endif // MAIN_H
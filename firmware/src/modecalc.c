@@ -0,0 +1,520 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modecalc.h"
+#include "modes.h"
+
+// The CVT and PLL calculations were originally written with float and double
+// arithmetic. They are reproduced here with integers so no soft-float code is
+// needed, while still giving exactly the same register values. Every value is
+// kept as an exact m * 2^e and each step of the original is rounded to the
+// same precision that step used, so the results match bit for bit.
+
+#define SGL_BITS 24
+#define DBL_BITS 53
+
+typedef struct
+{
+    uint64_t m;
+    int e;
+} XFloat;
+
+// Constants that were float literals in the original code
+static const XFloat PLL_K_MIN = { 13421773, -28 }; // 0.05f
+static const XFloat PLL_K_MAX = { 15938355, -24 }; // 0.95f
+static const XFloat H_SYNC_PER = { 10737418, -27 }; // 0.08f
+static const XFloat MIN_VSYNC_BP_SEC = { 9448928, -34 }; // 550.0f / 1000000.0f
+
+static int bit_length(uint64_t v)
+{
+    int n = 0;
+    uint32_t hi = v >> 32;
+    uint32_t lo = v;
+
+    if (hi)
+    {
+        n = 32;
+        lo = hi;
+    }
+
+    while (lo)
+    {
+        n++;
+        lo >>= 1;
+    }
+
+    return n;
+}
+
+// Round to nearest even with 'bits' of mantissa. sticky is set when there are
+// non-zero bits below m that have already been discarded.
+static XFloat xf_round(uint64_t m, int e, bool sticky, int bits)
+{
+    XFloat r;
+    int len = bit_length(m);
+
+    if (len > bits)
+    {
+        int d = len - bits;
+        uint64_t rem = m & ((1ULL << d) - 1);
+        uint64_t half = 1ULL << (d - 1);
+
+        m >>= d;
+        e += d;
+
+        if (rem > half || (rem == half && (sticky || (m & 1))))
+        {
+            m++;
+            if (m >> bits)
+            {
+                m >>= 1;
+                e++;
+            }
+        }
+    }
+
+    r.m = m;
+    r.e = e;
+    return r;
+}
+
+// (num / den) * 2^e, rounded
+static XFloat xf_div(uint64_t num, uint32_t den, int e, int bits)
+{
+    uint64_t q = num / den;
+    uint32_t r = num % den;
+    int need = bits + 2;
+
+    int len = bit_length(q);
+    while (len < need)
+    {
+        int step = need - len;
+        if (step > 32) step = 32;
+
+        uint64_t t = (uint64_t)r << step;
+        q = (q << step) | (t / den);
+        r = t % den;
+        e -= step;
+
+        len = bit_length(q);
+    }
+
+    return xf_round(q, e, r != 0, bits);
+}
+
+static XFloat xf_mul(XFloat a, uint32_t n, int bits)
+{
+    return xf_round(a.m * n, a.e, false, bits);
+}
+
+static XFloat xf_sub(XFloat a, XFloat b, int bits)
+{
+    if (a.e >= b.e)
+        return xf_round((a.m << (a.e - b.e)) - b.m, b.e, false, bits);
+    else
+        return xf_round(a.m - (b.m << (b.e - a.e)), a.e, false, bits);
+}
+
+static int xf_cmp(XFloat a, XFloat b)
+{
+    uint64_t am = a.m, bm = b.m;
+
+    if (a.e > b.e)
+        am <<= a.e - b.e;
+    else
+        bm <<= b.e - a.e;
+
+    return am < bm ? -1 : (am > bm ? 1 : 0);
+}
+
+static inline XFloat xf_int(uint32_t v)
+{
+    XFloat r = { v, 0 };
+    return r;
+}
+
+static uint32_t xf_trunc(XFloat a)
+{
+    return a.e >= 0 ? a.m << a.e : a.m >> -a.e;
+}
+
+static uint32_t getPLLdiv(uint32_t div)
+{
+	if (div & 1) return 0x20000 | (((div / 2) + 1) << 8) | (div / 2);
+	return ((div / 2) << 8) | (div / 2);
+}
+
+// Splits fvco/50 into the integer M and the fractional K, K is left as ko / 2^frac_bits
+static void pll_split(XFloat Fout, uint32_t c, uint32_t *pm, uint64_t *pko, int *frac_bits, XFloat *fvco_out)
+{
+    XFloat fvco = xf_mul(Fout, c, DBL_BITS);
+    XFloat q = xf_div(fvco.m, 50, fvco.e, DBL_BITS);
+
+    if (q.e >= 0)
+    {
+        *pm = q.m << q.e;
+        *pko = 0;
+        *frac_bits = 0;
+    }
+    else
+    {
+        *pm = q.m >> -q.e;
+        *pko = q.m & ((1ULL << -q.e) - 1);
+        *frac_bits = -q.e;
+    }
+
+    if (fvco_out) *fvco_out = xf_mul(q, 50, DBL_BITS);
+}
+
+static uint32_t pll_first_c(XFloat Fout)
+{
+	uint32_t c = 1;
+	while (xf_cmp(xf_mul(Fout, c, DBL_BITS), xf_int(400)) < 0) c++;
+	return c;
+}
+
+static int findPLLpar(XFloat Fout, uint32_t *pc, uint32_t *pm, uint64_t *pko, int *frac_bits)
+{
+	uint32_t c = pll_first_c(Fout);
+
+	while (1)
+	{
+		uint32_t m;
+		uint64_t ko;
+		int fbits;
+		XFloat fvco;
+
+		pll_split(Fout, c, &m, &ko, &fbits, &fvco);
+		XFloat kof = { ko, -fbits };
+
+		if (ko && (xf_cmp(kof, PLL_K_MIN) <= 0 || xf_cmp(kof, PLL_K_MAX) >= 0))
+		{
+			if (xf_cmp(fvco, xf_int(1500)) > 0)
+			{
+				return 0;
+			}
+			c++;
+		}
+		else
+		{
+			*pc = c;
+			*pm = m;
+			*pko = ko;
+			*frac_bits = fbits;
+			return 1;
+		}
+	}
+
+	//will never reach here
+	return 0;
+}
+
+static void pll_calc(XFloat Fout, PLLConfig *pll)
+{
+	uint64_t ko;
+	uint32_t m, c;
+	int frac_bits;
+
+	if (!findPLLpar(Fout, &c, &m, &ko, &frac_bits))
+	{
+		c = pll_first_c(Fout);
+
+		pll_split(Fout, c, &m, &ko, &frac_bits, NULL);
+		XFloat kof = { ko, -frac_bits };
+
+		//Make sure K is in allowed range.
+		if (xf_cmp(kof, PLL_K_MIN) <= 0)
+		{
+			ko = 0;
+		}
+		else if (xf_cmp(kof, PLL_K_MAX) >= 0)
+		{
+			m++;
+			ko = 0;
+		}
+	}
+
+	pll->m = getPLLdiv(m);
+	pll->c = getPLLdiv(c);
+
+	if (ko == 0)
+		pll->k = 1;
+	else if (frac_bits >= 32)
+		pll->k = ko >> (frac_bits - 32);
+	else
+		pll->k = ko << (32 - frac_bits);
+}
+
+static const int CELL_GRAN_RND = 4;
+
+static int determine_vsync(int w, int h)
+{
+    const int arx[] =   {4, 16, 16, 5, 15};
+    const int ary[] =   {3,  9, 10, 4, 9 };
+	const int vsync[] = {4,  5,  6, 7, 7 };
+
+    for (int ar = 0; ar < 5; ar++)
+    {
+        int w_calc = ((h * arx[ar]) / (ary[ar] * CELL_GRAN_RND)) * CELL_GRAN_RND;
+        if (w_calc == w)
+        {
+            return vsync[ar];
+        }
+    }
+
+    return 10;
+}
+
+static void calculate_cvt(int h_pixels, int v_lines, XFloat refresh_rate, bool reduced_blanking, VideoMode *vmode)
+{
+	// Based on xfree86 cvt.c and https://tomverbeure.github.io/video_timings_calculator
+
+	const int MIN_V_BPORCH = 6;
+	const int V_FRONT_PORCH = 3;
+
+	const int h_pixels_rnd = (h_pixels / CELL_GRAN_RND) * CELL_GRAN_RND;
+	const int v_sync = determine_vsync(h_pixels_rnd, v_lines);
+
+	int v_back_porch;
+	int h_blank, h_sync, h_back_porch, h_front_porch;
+
+	if (reduced_blanking)
+	{
+		const int RB_V_FPORCH = 3;
+		const uint32_t RB_MIN_V_BLANK = 460;
+
+		// ((1000000 / refresh_rate) - RB_MIN_V_BLANK) / v_lines
+		XFloat frame_us = xf_div(1000000, refresh_rate.m, -refresh_rate.e, SGL_BITS);
+		XFloat active_us = xf_sub(frame_us, xf_int(RB_MIN_V_BLANK), SGL_BITS);
+		XFloat h_period_est = xf_div(active_us.m, v_lines, active_us.e, SGL_BITS);
+		h_blank = 160;
+
+		int vbi_lines = xf_trunc(xf_div(RB_MIN_V_BLANK, h_period_est.m, -h_period_est.e, SGL_BITS)) + 1;
+
+		int rb_min_vbi = RB_V_FPORCH + v_sync + MIN_V_BPORCH;
+		int act_vbi_lines = (vbi_lines < rb_min_vbi) ? rb_min_vbi : vbi_lines;
+
+		v_back_porch = act_vbi_lines - V_FRONT_PORCH - v_sync;
+
+		h_sync = 32;
+		h_back_porch = 80;
+		h_front_porch = h_blank - h_sync - h_back_porch;
+	}
+	else
+	{
+		const uint32_t MIN_VSYNC_BP = 550;
+		const uint32_t C_PRIME = 30;
+		const uint32_t M_PRIME = 300;
+
+		// ((1 / refresh_rate) - MIN_VSYNC_BP / 1000000) / (v_lines + V_FRONT_PORCH) * 1000000
+		XFloat frame_sec = xf_div(1, refresh_rate.m, -refresh_rate.e, SGL_BITS);
+		XFloat active_sec = xf_sub(frame_sec, MIN_VSYNC_BP_SEC, SGL_BITS);
+		XFloat line_sec = xf_div(active_sec.m, v_lines + V_FRONT_PORCH, active_sec.e, SGL_BITS);
+		XFloat h_period_est = xf_mul(line_sec, 1000000, SGL_BITS);
+
+		int v_sync_bp = xf_trunc(xf_div(MIN_VSYNC_BP, h_period_est.m, -h_period_est.e, SGL_BITS)) + 1;
+		if (v_sync_bp < (v_sync + MIN_V_BPORCH))
+		{
+			v_sync_bp = v_sync + MIN_V_BPORCH;
+		}
+
+		v_back_porch = v_sync_bp - v_sync;
+
+		// C_PRIME - (M_PRIME * h_period_est / 1000)
+		XFloat m_term = xf_mul(h_period_est, M_PRIME, SGL_BITS);
+		m_term = xf_div(m_term.m, 1000, m_term.e, SGL_BITS);
+
+		bool small_duty_cycle = true;
+		XFloat ideal_duty_cycle;
+		if (xf_cmp(m_term, xf_int(C_PRIME)) < 0)
+		{
+			ideal_duty_cycle = xf_sub(xf_int(C_PRIME), m_term, SGL_BITS);
+			small_duty_cycle = xf_cmp(ideal_duty_cycle, xf_int(20)) < 0;
+		}
+
+		if (small_duty_cycle)
+		{
+			h_blank = (h_pixels_rnd / 4 / (2 * CELL_GRAN_RND)) * (2 * CELL_GRAN_RND);
+		}
+		else
+		{
+			// h_pixels_rnd * ideal_duty_cycle / (100 - ideal_duty_cycle)
+			XFloat num = xf_mul(ideal_duty_cycle, h_pixels_rnd, SGL_BITS);
+			XFloat den = xf_sub(xf_int(100), ideal_duty_cycle, SGL_BITS);
+			XFloat blank = xf_div(num.m, den.m, num.e - den.e, SGL_BITS);
+			h_blank = (xf_trunc(blank) / (2 * CELL_GRAN_RND)) * (2 * CELL_GRAN_RND);
+		}
+
+		int total_pixels = h_pixels_rnd + h_blank;
+
+		h_sync = (xf_trunc(xf_mul(H_SYNC_PER, total_pixels, SGL_BITS)) / CELL_GRAN_RND) * CELL_GRAN_RND;
+		h_back_porch = h_blank / 2;
+		h_front_porch = h_blank - h_sync - h_back_porch;
+	}
+
+	vmode->hact = h_pixels_rnd;
+	vmode->hfp = h_front_porch;
+	vmode->hs = h_sync;
+	vmode->hbp = h_back_porch;
+	vmode->vact = v_lines;
+	vmode->vfp = V_FRONT_PORCH - 1;
+	vmode->vs = v_sync;
+	vmode->vbp = v_back_porch + 1;
+}
+
+// CVT reduced blanking v2. The blanking is fixed apart from the vertical front
+// porch, which grows until the vertical blank lasts at least 460us.
+static void calculate_cvt_rb2(int h_pixels, int v_lines, uint32_t millihz, VideoMode *vmode)
+{
+	const int RB2_H_FPORCH = 8;
+	const int RB2_H_SYNC = 32;
+	const int RB2_H_BPORCH = 40;
+	const int RB2_MIN_V_FPORCH = 1;
+	const int RB2_V_SYNC = 8;
+	const int RB2_V_BPORCH = 6;
+	const uint32_t RB_MIN_V_BLANK_NS = 460000;
+
+	uint32_t frame_ns = 1000000000000ULL / millihz;
+	uint32_t h_period_est = (frame_ns - RB_MIN_V_BLANK_NS) / v_lines;
+
+	int vbi_lines = (RB_MIN_V_BLANK_NS / h_period_est) + 1;
+	int rb_min_vbi = RB2_MIN_V_FPORCH + RB2_V_SYNC + RB2_V_BPORCH;
+	if (vbi_lines < rb_min_vbi) vbi_lines = rb_min_vbi;
+
+	vmode->hact = h_pixels;
+	vmode->hfp = RB2_H_FPORCH;
+	vmode->hs = RB2_H_SYNC;
+	vmode->hbp = RB2_H_BPORCH;
+	vmode->vact = v_lines;
+	vmode->vfp = vbi_lines - RB2_V_SYNC - RB2_V_BPORCH;
+	vmode->vs = RB2_V_SYNC;
+	vmode->vbp = RB2_V_BPORCH;
+}
+
+// Short fixed front porches and syncs, the rest of the blanking goes to the
+// back porches
+static void calculate_minimal(int h_pixels, int v_lines, int h_blank, int v_blank, VideoMode *vmode)
+{
+	const int MIN_H_FPORCH = 8;
+	const int MIN_H_SYNC = 32;
+	const int MIN_V_FPORCH = 1;
+	const int MIN_V_SYNC = 3;
+
+	if (h_blank < MIN_HBLANK) h_blank = MIN_HBLANK;
+	if (v_blank < MIN_VBLANK) v_blank = MIN_VBLANK;
+
+	vmode->hact = h_pixels;
+	vmode->hfp = MIN_H_FPORCH;
+	vmode->hs = MIN_H_SYNC;
+	vmode->hbp = h_blank - MIN_H_FPORCH - MIN_H_SYNC;
+	vmode->vact = v_lines;
+	vmode->vfp = MIN_V_FPORCH;
+	vmode->vs = MIN_V_SYNC;
+	vmode->vbp = v_blank - MIN_V_FPORCH - MIN_V_SYNC;
+}
+
+static uint32_t pixel_khz(const VideoMode *mode, uint32_t millihz)
+{
+    return ((uint64_t)video_mode_pixels(mode) * millihz) / 1000000;
+}
+
+bool hdmi_calc_video_mode(uint16_t width, uint16_t height, uint32_t millihz, const Blanking *blanking, VideoMode *mode)
+{
+    if (blanking->type == BLANKING_CVT_RB2)
+    {
+        calculate_cvt_rb2(width, height, millihz, mode);
+        mode->khz = pixel_khz(mode, millihz);
+    }
+    else if (blanking->type == BLANKING_MINIMAL)
+    {
+        calculate_minimal(width, height, blanking->hblank, blanking->vblank, mode);
+        mode->khz = pixel_khz(mode, millihz);
+    }
+    else
+    {
+        bool rb = (width * height) > ( 1920 * 1080);
+        XFloat hz = xf_div(millihz, 1000, 0, SGL_BITS);
+
+        calculate_cvt(width, height, hz, rb, mode);
+        mode->khz = pixel_khz(mode, millihz);
+
+        if (!rb && mode->khz > HDMI_MAX_KHZ)
+        {
+            calculate_cvt(width, height, hz, true, mode);
+            mode->khz = pixel_khz(mode, millihz);
+        }
+    }
+
+    return mode->khz <= HDMI_MAX_KHZ;
+}
+
+bool hdmi_calc_mode_blanking(uint16_t width, uint16_t height, uint32_t millihz, const Blanking *blanking, ModeTiming *timing)
+{
+    if (!hdmi_calc_video_mode(width, height, millihz, blanking, &timing->mode))
+    {
+        static const ModeTiming unavailable = { 0 };
+        *timing = unavailable;
+        return false;
+    }
+
+    // Single precision pixels * hz, then divided in double precision
+    XFloat hz = xf_div(millihz, 1000, 0, SGL_BITS);
+    XFloat pixel_hz = xf_round(hz.m * video_mode_pixels(&timing->mode), hz.e, false, SGL_BITS);
+    XFloat mhz = xf_div(pixel_hz.m, 1000000, pixel_hz.e, DBL_BITS);
+
+    pll_calc(mhz, &timing->pll);
+    return true;
+}
+
+bool hdmi_calc_mode(uint16_t width, uint16_t height, uint32_t millihz, ModeTiming *timing)
+{
+    static const Blanking standard = { BLANKING_STANDARD, 0, 0 };
+    return hdmi_calc_mode_blanking(width, height, millihz, &standard, timing);
+}
+
+static void core_calc(const VideoMode *mode, uint32_t millihz, int clock_shift, ModeTiming *timing)
+{
+    XFloat hz = xf_div(millihz, 1000, 0, SGL_BITS);
+
+    timing->mode = *mode;
+    timing->mode.khz = pixel_khz(&timing->mode, millihz);
+
+    // Single precision pixels * hz, divided in double and stored as single
+    XFloat pixel_hz = xf_round(hz.m * video_mode_pixels(&timing->mode), hz.e, false, SGL_BITS);
+    XFloat mhz = xf_div(pixel_hz.m, 1000000, pixel_hz.e, DBL_BITS);
+    mhz = xf_round(mhz.m, mhz.e, false, SGL_BITS);
+
+    mhz.e += clock_shift;
+    pll_calc(mhz, &timing->pll);
+}
+
+void core_calc_mode(uint32_t millihz, bool wide, ModeTiming *timing)
+{
+    // Core clock runs at 4x the pixel clock
+    core_calc(&core_modes[wide ? 1 : 0], millihz, 2, timing);
+}
+
+void core_calc_native_mode(uint32_t millihz, ModeTiming *timing)
+{
+    // Core clock runs at 2x the pixel clock
+    core_calc(&core_native_mode, millihz, 1, timing);
+}
+
+void core_calc_interlaced_mode(uint32_t millihz, bool pal, ModeTiming *timing)
+{
+    const VideoMode *field = &core_interlaced_modes[pal ? 1 : 0];
+    VideoMode frame = *field;
+
+    frame.vact = (field->vact * 2) + 1;
+    frame.vfp = field->vfp * 2;
+    frame.vs = field->vs * 2;
+    frame.vbp = field->vbp * 2;
+
+    // Core clock runs at 2x the pixel clock
+    core_calc(&frame, millihz / 2, 1, timing);
+
+    uint32_t khz = timing->mode.khz;
+    timing->mode = *field;
+    timing->mode.khz = khz;
+}
@@ -0,0 +1,96 @@
+#if !defined(MODECALC_H)
+#define MODECALC_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Video timing and PLL calculations. These have no hardware dependencies so
+// they are also built on the host by genmodes to precompute the mode tables.
+// Refresh rates are in millihertz and everything is integer arithmetic, so no
+// soft-float support is pulled into the firmware.
+
+typedef struct
+{
+	uint16_t hact;
+	uint16_t hfp;
+	uint16_t hs;
+	uint16_t hbp;
+	uint16_t vact;
+	uint16_t vfp;
+	uint16_t vs;
+	uint16_t vbp;
+
+    uint32_t khz; // pixel clock
+} VideoMode;
+
+// Register values for the M, C and K counters of a fractional PLL
+typedef struct
+{
+    uint32_t m;
+    uint32_t c;
+    uint32_t k;
+} PLLConfig;
+
+typedef struct
+{
+    VideoMode mode;
+    PLLConfig pll;
+} ModeTiming;
+
+static inline uint32_t video_mode_pixels(const VideoMode *m)
+{
+    return ( m->hact + m->hbp + m->hfp + m->hs ) * ( m->vact + m->vbp + m->vfp + m->vs );
+}
+
+static inline bool mode_timing_valid(const ModeTiming *t)
+{
+    return t->mode.khz != 0;
+}
+
+// Highest HDMI pixel clock, about that of MiSTer's own 2048x1536@60 mode
+#define HDMI_MAX_KHZ 210000
+
+typedef enum
+{
+    BLANKING_STANDARD, // CVT, with reduced blanking where needed
+    BLANKING_CVT_RB2,  // CVT reduced blanking v2
+    BLANKING_MINIMAL,  // hblank and vblank set by the user
+    NUM_BLANKING
+} BlankingType;
+
+typedef struct
+{
+    BlankingType type;
+
+    // Total blanking for BLANKING_MINIMAL, in pixels and lines
+    uint16_t hblank;
+    uint16_t vblank;
+} Blanking;
+
+// Smallest blanking BLANKING_MINIMAL accepts, enough for the sync pulses and
+// the shortest porches
+#define MIN_HBLANK 48
+#define MIN_VBLANK 6
+
+// Uses CVT timings, or CVT reduced blanking for large modes and wherever
+// standard blanking would exceed HDMI_MAX_KHZ. Returns false and leaves the
+// timing zeroed when even reduced blanking is too fast.
+bool hdmi_calc_mode(uint16_t width, uint16_t height, uint32_t millihz, ModeTiming *timing);
+
+// Like hdmi_calc_mode but with the given blanking. BLANKING_STANDARD gives
+// the same result as hdmi_calc_mode, the others never fall back to different
+// blanking and fail if they exceed HDMI_MAX_KHZ.
+bool hdmi_calc_mode_blanking(uint16_t width, uint16_t height, uint32_t millihz, const Blanking *blanking, ModeTiming *timing);
+
+// Only the video timing of hdmi_calc_mode_blanking, without the slower PLL
+// search. Returns false if the mode cannot be output.
+bool hdmi_calc_video_mode(uint16_t width, uint16_t height, uint32_t millihz, const Blanking *blanking, VideoMode *mode);
+
+void core_calc_mode(uint32_t millihz, bool wide, ModeTiming *timing);
+void core_calc_native_mode(uint32_t millihz, ModeTiming *timing);
+
+// 'millihz' is the field rate. The timing is that of one field, the PLL is
+// set for the whole frame including the extra line of the second field.
+void core_calc_interlaced_mode(uint32_t millihz, bool pal, ModeTiming *timing);
+
+#endif // MODECALC_H
@@ -0,0 +1,121 @@
+#include "modes.h"
+
+const HDMIResolution hdmi_resolutions[NUM_HDMI_RESOLUTIONS] =
+{
+    {  640,  480, false },
+    {  800,  600, false },
+    { 1280,  720, true },
+    { 1024,  768, false },
+    { 1366,  768, false },
+    { 1280,  960, false },
+    { 1708,  960, true },
+    { 1920, 1080, true },
+    { 1600, 1200, false },
+    { 1792, 1344, false },
+    { 1920, 1440, false },
+    { 2048, 1536, false }
+};
+
+const uint32_t hdmi_refresh_rates[NUM_HDMI_REFRESH_RATES] =
+{
+    24000,
+    30000,
+    50000,
+    51000,
+    52000,
+    53000,
+    54000,
+    55000,
+    56000,
+    57000,
+    58000,
+    59000,
+    59940,
+    60000,
+    61000,
+    62000,
+    63000,
+    64000,
+    65000,
+    72000,
+    100000,
+    119880,
+    120000,
+    144000,
+    165000,
+    240000
+};
+
+const VideoMode core_modes[2] =
+{
+    {
+        .hact = 320, .hfp = 8, .hs = 32, .hbp = 40,
+        .vact = 240, .vfp = 3, .vs = 4, .vbp = 6
+    },
+    {
+        .hact = 384, .hfp = 16, .hs = 32, .hbp = 48,
+        .vact = 216, .vfp = 3, .vs = 5, .vbp = 6
+    }
+};
+
+// Short blanking keeps 72hz under CORE_NATIVE_MAX_KHZ. vbp is even so it
+// lands on a doubled line.
+const VideoMode core_native_mode =
+{
+    .hact = 640, .hfp = 8, .hs = 16, .hbp = 24,
+    .vact = 480, .vfp = 2, .vs = 4, .vbp = 8
+};
+
+// 780x525 and 944x625 frames at square pixel clocks, with the 640x480 image
+// centred in the 576i active area
+const VideoMode core_interlaced_modes[2] =
+{
+    {
+        .hact = 640, .hfp = 16, .hs = 56, .hbp = 68,
+        .vact = 240, .vfp = 3, .vs = 3, .vbp = 16
+    },
+    {
+        .hact = 640, .hfp = 84, .hs = 64, .hbp = 156,
+        .vact = 240, .vfp = 26, .vs = 3, .vbp = 43
+    }
+};
+
+int modes_find_refresh(uint32_t millihz)
+{
+    for( int i = 0; i < NUM_HDMI_REFRESH_RATES; i++ )
+    {
+        if (hdmi_refresh_rates[i] == millihz) return i;
+    }
+
+    return -1;
+}
+
+static uint32_t divided_refresh(uint32_t millihz, uint32_t pixels, uint32_t max_khz)
+{
+    uint32_t core_millihz = millihz;
+    for (uint32_t n = 2; ((uint64_t)pixels * core_millihz) / 1000000 > max_khz; n++)
+    {
+        core_millihz = millihz / n;
+    }
+
+    return core_millihz;
+}
+
+uint32_t modes_core_refresh(uint32_t millihz)
+{
+    uint32_t pixels = video_mode_pixels(&core_modes[0]);
+    if (video_mode_pixels(&core_modes[1]) > pixels) pixels = video_mode_pixels(&core_modes[1]);
+
+    return divided_refresh(millihz, pixels, CORE_MAX_KHZ);
+}
+
+uint32_t modes_native_refresh(uint32_t millihz)
+{
+    return divided_refresh(millihz, video_mode_pixels(&core_native_mode), CORE_NATIVE_MAX_KHZ);
+}
+
+bool modes_native_available(int mode_idx)
+{
+    return hdmi_resolutions[mode_idx].width == core_native_mode.hact
+            && hdmi_resolutions[mode_idx].height == core_native_mode.vact;
+}
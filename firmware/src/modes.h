@@ -0,0 +1,75 @@
+#if !defined(MODES_H)
+#define MODES_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "modecalc.h"
+
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    bool wide;
+} HDMIResolution;
+
+#define NUM_HDMI_RESOLUTIONS 12
+#define NUM_HDMI_REFRESH_RATES 26
+
+extern const HDMIResolution hdmi_resolutions[NUM_HDMI_RESOLUTIONS];
+
+// In millihertz
+extern const uint32_t hdmi_refresh_rates[NUM_HDMI_REFRESH_RATES];
+
+// 240p core timings, indexed by wide
+extern const VideoMode core_modes[2];
+
+// Highest core pixel clock. The system clock runs at four times this, which
+// is as fast as the core logic is clocked.
+#define CORE_MAX_KHZ 12500
+
+// Native core timing, output at the HDMI resolution with every tile pixel
+// doubled. The system clock runs at twice the pixel clock, so it can be twice
+// as fast.
+extern const VideoMode core_native_mode;
+#define CORE_NATIVE_MAX_KHZ (CORE_MAX_KHZ * 2)
+
+// Interlaced core timings of a single field, 480i then 576i. Tile pixels are
+// doubled horizontally and each field shows the whole 320x240 layout. These
+// also run the system clock at twice the pixel clock.
+extern const VideoMode core_interlaced_modes[2];
+
+// Field rates of the interlaced timings
+#define CORE_480I_MILLIHZ 59940
+#define CORE_576I_MILLIHZ 50000
+
+typedef enum
+{
+    CORE_240P,
+    CORE_NATIVE,
+    CORE_480I,
+    CORE_576I,
+    NUM_CORE_FORMATS
+} CoreFormat;
+
+// Generated at build time by genmodes. HDMI modes that cannot be output are
+// left zeroed, see mode_timing_valid().
+extern const ModeTiming hdmi_mode_table[NUM_HDMI_RESOLUTIONS][NUM_HDMI_REFRESH_RATES];
+extern const ModeTiming core_mode_table[2][NUM_HDMI_REFRESH_RATES];
+extern const ModeTiming core_native_table[NUM_HDMI_REFRESH_RATES];
+extern const ModeTiming core_interlaced_table[2];
+
+int modes_find_refresh(uint32_t millihz);
+
+// Core refresh rate used with an HDMI refresh rate. Rates that would need a
+// core clock above CORE_MAX_KHZ run the core at an integer fraction of the
+// HDMI rate, so every core frame is shown for a whole number of HDMI frames.
+uint32_t modes_core_refresh(uint32_t millihz);
+
+// As modes_core_refresh for the native core timing
+uint32_t modes_native_refresh(uint32_t millihz);
+
+// True if the core can output the HDMI resolution natively
+bool modes_native_available(int mode_idx);
+
+#endif // MODES_H
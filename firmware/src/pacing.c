@@ -0,0 +1,240 @@
+#include "pacing.h"
+
+// The lead in, long enough to let the sensor settle and unlike any later run
+#define LEAD_DARK_FRAMES 12
+#define LEAD_LIGHT_FRAMES 6
+
+// Frames stay logged long enough to cover the latency of any display
+#define FRAME_LOG_SIZE 64
+#define EDGE_LOG_SIZE 32
+
+// Changes further than this from the refresh grid are delayed, in 1/256ths of
+// a refresh
+#define GRID_TOLERANCE 64
+
+typedef struct
+{
+    uint32_t ticks;
+    bool level;
+} LogEntry;
+
+static LogEntry frame_log[FRAME_LOG_SIZE];
+static volatile uint32_t frame_head;
+
+static LogEntry edge_log[EDGE_LOG_SIZE];
+static volatile uint32_t edge_head;
+static uint32_t edge_tail;
+
+// Sequence generator
+static uint16_t lfsr;
+static uint32_t seq_frames;
+static uint8_t run_left;
+static bool run_level;
+
+// 1/256th of a refresh in ticks
+static uint32_t grid_unit;
+
+// First frame the next change can be matched to
+static uint32_t next_frame;
+
+static PacingStats stats;
+
+void pacing_reset(uint32_t refresh_ticks)
+{
+    frame_head = 0;
+    edge_head = 0;
+    edge_tail = 0;
+
+    lfsr = 0xace1;
+    seq_frames = 0;
+    run_left = LEAD_DARK_FRAMES;
+    run_level = false;
+
+    grid_unit = refresh_ticks >> 8;
+    next_frame = 0;
+
+    stats = (PacingStats){ 0 };
+}
+
+// Runs of 2 or 3 frames, picked by a 16 bit Galois LFSR
+static uint8_t next_run_length()
+{
+    lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? 0xb400 : 0);
+    return 2 + (lfsr & 1);
+}
+
+bool pacing_vblank(uint32_t frame_start_ticks)
+{
+    // The first call has no frame of the sequence to log yet
+    if (seq_frames > 0)
+    {
+        LogEntry *f = &frame_log[frame_head % FRAME_LOG_SIZE];
+        f->ticks = frame_start_ticks;
+        f->level = run_level;
+        frame_head++;
+    }
+
+    if (run_left == 0)
+    {
+        run_level = !run_level;
+        run_left = seq_frames == LEAD_DARK_FRAMES ? LEAD_LIGHT_FRAMES : next_run_length();
+    }
+
+    run_left--;
+    seq_frames++;
+    return run_level;
+}
+
+void pacing_edge(uint32_t ticks, bool level)
+{
+    LogEntry *e = &edge_log[edge_head % EDGE_LOG_SIZE];
+    e->ticks = ticks;
+    e->level = level;
+    edge_head++;
+}
+
+static void add_event(uint8_t type, uint8_t refreshes, uint32_t frame)
+{
+    PacingEvent *ev = &stats.events[stats.num_events % PACING_MAX_EVENTS];
+    ev->type = type;
+    ev->refreshes = refreshes;
+    ev->frame = frame;
+    stats.num_events++;
+
+    PacingEventSummary *sum = &stats.summary[type];
+    if (sum->events == 0) sum->first_frame = frame;
+    sum->last_frame = frame;
+    sum->events++;
+}
+
+static void match_edge(uint32_t ticks, bool level, uint32_t frames)
+{
+    // Frames older than this may have been overwritten
+    uint32_t oldest = frames > FRAME_LOG_SIZE ? frames - FRAME_LOG_SIZE + 2 : 1;
+
+    if (!stats.started)
+    {
+        // Anything before the light run of the lead in is left over from
+        // before the start
+        if (!level || frames <= LEAD_DARK_FRAMES || LEAD_DARK_FRAMES < oldest) return;
+
+        uint32_t lead_ticks = frame_log[LEAD_DARK_FRAMES % FRAME_LOG_SIZE].ticks;
+        if ((int32_t)(ticks - lead_ticks) < 0) return;
+
+        stats.started = true;
+        stats.latency_ticks = ticks - lead_ticks;
+        stats.changes++;
+        next_frame = LEAD_DARK_FRAMES + 1;
+        return;
+    }
+
+    if (next_frame < oldest) next_frame = oldest;
+
+    // The change is the start of a run with the new level. Of the runs that
+    // could have caused it, take the one that needs the smallest change of lag.
+    bool found = false;
+    uint32_t best_frame = 0;
+    int32_t best_pos = 0;
+    uint32_t best_dist = 0;
+
+    for (uint32_t k = next_frame; k < frames; k++)
+    {
+        const LogEntry *f = &frame_log[k % FRAME_LOG_SIZE];
+        if ((int32_t)(ticks - f->ticks) < 0) break;
+        if (f->level != level || frame_log[(k - 1) % FRAME_LOG_SIZE].level == level) continue;
+
+        // Position on the refresh grid, in 1/256ths of a refresh
+        int32_t pos = (int32_t)(ticks - f->ticks - stats.latency_ticks) / (int32_t)grid_unit;
+        int32_t d = pos - (stats.lag * 256);
+        uint32_t dist = d < 0 ? -d : d;
+
+        if (!found || dist < best_dist)
+        {
+            found = true;
+            best_frame = k;
+            best_pos = pos;
+            best_dist = dist;
+        }
+    }
+
+    if (!found)
+    {
+        stats.unmatched++;
+        return;
+    }
+
+    int32_t lag = (best_pos + (best_pos < 0 ? -128 : 128)) / 256;
+    int32_t frac = best_pos - (lag * 256);
+    bool off_grid = frac > GRID_TOLERANCE || frac < -GRID_TOLERANCE;
+
+    // A change between refreshes only moves the lag by the whole refreshes
+    // it is away from the current one
+    if (off_grid) lag = stats.lag + ((best_pos - (stats.lag * 256)) / 256);
+
+    if (lag > stats.lag)
+    {
+        stats.repeated += lag - stats.lag;
+        add_event(PACING_REPEATED, lag - stats.lag, best_frame);
+    }
+    else if (lag < stats.lag)
+    {
+        stats.dropped += stats.lag - lag;
+        add_event(PACING_DROPPED, stats.lag - lag, best_frame);
+    }
+
+    if (off_grid)
+    {
+        stats.delayed++;
+        add_event(PACING_DELAYED, 0, best_frame);
+    }
+    else
+    {
+        // Follow slow drift between the frames and the display refresh
+        stats.latency_ticks += (frac * (int32_t)grid_unit) / 16;
+    }
+
+    stats.lag = lag;
+    stats.changes++;
+    next_frame = best_frame + 1;
+}
+
+void pacing_process()
+{
+    uint32_t frames = frame_head;
+    stats.frames = frames;
+    if (frames == 0) return;
+
+    // An edge is only matched once a frame has started after it, so every
+    // frame that could have caused it is in the log
+    uint32_t newest_ticks = frame_log[(frames - 1) % FRAME_LOG_SIZE].ticks;
+
+    while (edge_tail != edge_head)
+    {
+        if (edge_head - edge_tail > EDGE_LOG_SIZE)
+        {
+            stats.unmatched += edge_head - edge_tail - EDGE_LOG_SIZE;
+            edge_tail = edge_head - EDGE_LOG_SIZE;
+        }
+
+        LogEntry e = edge_log[edge_tail % EDGE_LOG_SIZE];
+        if ((int32_t)(e.ticks - newest_ticks) >= 0) break;
+
+        match_edge(e.ticks, e.level, frames);
+        edge_tail++;
+    }
+}
+
+const PacingStats *pacing_stats()
+{
+    return &stats;
+}
+
+const PacingEvent *pacing_event(uint32_t index)
+{
+    return &stats.events[(stats.num_events - 1 - index) % PACING_MAX_EVENTS];
+}
+
+uint32_t pacing_num_logged()
+{
+    return stats.num_events < PACING_MAX_EVENTS ? stats.num_events : PACING_MAX_EVENTS;
+}
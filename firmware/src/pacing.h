@@ -0,0 +1,86 @@
+#if !defined( PACING_H )
+#define PACING_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frame pacing analysis. The test patch follows a pseudo random sequence of
+// light and dark runs, each 2 or 3 frames long, so every change the sensor
+// sees can be matched to the frame that caused it. The sequence starts with
+// a dark lead in and then a longer light run, which sets the baseline latency.
+//
+// Each matched change is placed on the display's refresh grid relative to the
+// baseline. Its lag is how many refreshes late it is, so a lag that grows
+// means the display repeated a frame and one that shrinks means it dropped
+// one. A change that falls between refreshes is counted as delayed. Like
+// response.c this has no hardware dependencies.
+//
+// The latest events are logged with the frame that showed them, and each type
+// also keeps the frames of its first and latest event, so a long run still
+// shows when the trouble started after the log has wrapped.
+
+#define PACING_MAX_EVENTS 64
+
+typedef enum
+{
+    PACING_DROPPED,
+    PACING_REPEATED,
+    PACING_DELAYED,
+    PACING_NUM_EVENT_TYPES
+} PacingEventType;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t refreshes; // refreshes dropped or repeated, 0 for a delay
+    uint32_t frame;    // frame whose change showed it, counted from the start
+} PacingEvent;
+
+typedef struct
+{
+    uint32_t events;      // events of this type
+    uint32_t first_frame; // frame of the first one, counted from the start
+    uint32_t last_frame;  // frame of the latest one
+} PacingEventSummary;
+
+typedef struct
+{
+    bool started;            // the lead in has been seen
+    uint32_t frames;         // frames sent since the start
+    uint32_t changes;        // light changes matched to a frame
+    uint32_t unmatched;      // light changes with no frame to match
+    uint32_t dropped;        // refreshes dropped
+    uint32_t repeated;       // refreshes repeated
+    uint32_t delayed;        // changes off the refresh grid
+    int32_t lag;             // refreshes behind the baseline
+    uint32_t latency_ticks;  // baseline latency from the frame start
+
+    uint32_t num_events;     // events so far, the latest are in 'events'
+    PacingEvent events[PACING_MAX_EVENTS];
+    PacingEventSummary summary[PACING_NUM_EVENT_TYPES];
+} PacingStats;
+
+// 'refresh_ticks' is the period of the display refresh, which is shorter than
+// the frame period when each frame is shown more than once
+void pacing_reset(uint32_t refresh_ticks);
+
+// Call once per frame from vblank with the start time of the frame that has
+// just been shown. Returns the level of the patch for the next frame. This and
+// pacing_edge can run in interrupt handlers while pacing_process runs.
+bool pacing_vblank(uint32_t frame_start_ticks);
+
+// The sensor changed to 'level' at 'ticks'
+void pacing_edge(uint32_t ticks, bool level);
+
+// Matches the edges that have been added so far against the frames
+void pacing_process();
+
+const PacingStats *pacing_stats();
+
+// Event at 'index' counting back from the latest, 0 to PACING_MAX_EVENTS - 1
+const PacingEvent *pacing_event(uint32_t index);
+
+// Number of events still in the log
+uint32_t pacing_num_logged();
+
+#endif // PACING_H
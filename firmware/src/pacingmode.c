@@ -0,0 +1,156 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "interrupts.h"
+#include "pacing.h"
+#include "pacingmode.h"
+#include "main.h"
+
+// Frame pacing drives the test patch with the pacing sequence from vblank and
+// matches every sensor change to the frame that caused it, counting the
+// refreshes the display drops or repeats. The sensor filter is at its widest
+// so a PWM backlight does not add changes of its own.
+#define PACING_FILTER_CYCLES 0xffff
+#define PACING_EVENT_LINES 4
+
+volatile bool pacing_running = false;
+
+static const char *pacing_event_names[PACING_NUM_EVENT_TYPES] = { "Dropped", "Repeated", "Delayed" };
+
+// Log lines scrolled past, counting back from the latest event
+static uint32_t pacing_scroll;
+
+// Events are timed by frame count in tenths of a second, the tick count wraps
+// on long runs
+static uint32_t pacing_frame_ds(uint32_t frame)
+{
+    return ((uint64_t)frame * 10000) / core_millihz;
+}
+
+void pacing_start()
+{
+    // Each frame is shown core_hdmi_frames times
+    uint32_t refresh_ticks = ((uint64_t)CLOCK_REF_KHZ * 1000000) / ((uint64_t)core_millihz * core_hdmi_frames);
+
+    disable_interrupts();
+    pacing_running = false;
+    input_filter_width(SENSOR_PIN, PACING_FILTER_CYCLES);
+    intctrl_edge_fall(INT_SRC_SENSOR);
+    pacing_reset(refresh_ticks);
+    pacing_running = true;
+    enable_interrupts();
+
+    pacing_scroll = 0;
+}
+
+void pacing_stop()
+{
+    disable_interrupts();
+    pacing_running = false;
+    intctrl_edge_fall(0);
+    input_filter_width(SENSOR_PIN, SENSOR_FILTER_CYCLES);
+    enable_interrupts();
+
+    palette_ram[0x80] = 0x0000;
+    set_state(ST_CLEAR);
+}
+
+void draw_pacing()
+{
+    uint16_t pressed = input_pressed();
+    if (pressed & INPUT_OK)
+    {
+        pacing_start();
+    }
+
+    pacing_process();
+    const PacingStats *stats = pacing_stats();
+
+    uint32_t logged = pacing_num_logged();
+    if ((pressed & INPUT_DOWN) && pacing_scroll + PACING_EVENT_LINES < logged) pacing_scroll += PACING_EVENT_LINES;
+    if ((pressed & INPUT_UP) && pacing_scroll >= PACING_EVENT_LINES) pacing_scroll -= PACING_EVENT_LINES;
+    if (pacing_scroll >= logged) pacing_scroll = 0;
+
+    draw_test_bars();
+
+    gfx_begin_window(ALIGN_MIDDLE | align_info(), 2, 0, 24, PACING_EVENT_LINES + 20, 0);
+    gfx_pen(TEXT_BLUE);
+    gfx_text("FRAME PACING");
+    gfx_newline(1);
+    gfx_pen(TEXT_GRAY);
+
+    if (!stats->started)
+    {
+        gfx_textf("Frames: %u", stats->frames);
+        gfx_text("Waiting for lead in");
+        gfx_newline(PACING_EVENT_LINES + 11);
+    }
+    else
+    {
+        char ms[CLOCK_MS_STR_LEN];
+        clock_ticks_to_ms_str(stats->latency_ticks, ms);
+
+        gfx_textf("Frames: %u", stats->frames);
+        gfx_textf("Changes: %u", stats->changes);
+
+        // Totals with the times of the first and latest event of each type,
+        // which outlast the log on a long run
+        const uint32_t totals[PACING_NUM_EVENT_TYPES] = { stats->dropped, stats->repeated, stats->delayed };
+        for (int t = 0; t < PACING_NUM_EVENT_TYPES; t++)
+        {
+            const PacingEventSummary *sum = &stats->summary[t];
+            gfx_textf("%s: %u", pacing_event_names[t], totals[t]);
+            if (sum->events == 0)
+            {
+                gfx_newline(1);
+                continue;
+            }
+
+            uint32_t first = pacing_frame_ds(sum->first_frame);
+            uint32_t last = pacing_frame_ds(sum->last_frame);
+            gfx_textf("  %u.%us to %u.%us", first / 10, first % 10, last / 10, last % 10);
+        }
+
+        gfx_textf("Unmatched: %u", stats->unmatched);
+        gfx_textf("Latency: %s ms", ms);
+        gfx_textf("Lag: %d refreshes", stats->lag);
+        gfx_newline(1);
+
+        uint32_t count = logged - pacing_scroll < PACING_EVENT_LINES ? logged - pacing_scroll : PACING_EVENT_LINES;
+
+        gfx_pen(TEXT_BLUE);
+        if (count == 0)
+        {
+            gfx_text("Log");
+        }
+        else
+        {
+            gfx_textf("Log %u-%u of %u", pacing_scroll + 1, pacing_scroll + count, logged);
+        }
+        gfx_pen(TEXT_GRAY);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const PacingEvent *ev = pacing_event(pacing_scroll + i);
+            uint32_t ds = pacing_frame_ds(ev->frame);
+
+            if (ev->type == PACING_DELAYED)
+            {
+                gfx_textf("%5u.%us %s", ds / 10, ds % 10, pacing_event_names[ev->type]);
+            }
+            else
+            {
+                gfx_textf("%5u.%us %s %u", ds / 10, ds % 10, pacing_event_names[ev->type], ev->refreshes);
+            }
+        }
+        gfx_newline(PACING_EVENT_LINES - count);
+    }
+
+    gfx_newline(1);
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("A to restart, B to exit.");
+    gfx_text("Up/Down to scroll log.");
+    gfx_end_window();
+}
@@ -0,0 +1,16 @@
+#if !defined( PACINGMODE_H )
+#define PACINGMODE_H 1
+
+#include <stdbool.h>
+
+// Frame pacing screen, which drives the patch with the sequence from pacing.c
+// and shows the dropped, repeated and delayed refreshes it finds
+
+// Set while frame pacing drives the test patch and takes both sensor edges
+extern volatile bool pacing_running;
+
+void pacing_start();
+void pacing_stop();
+void draw_pacing();
+
+#endif // PACINGMODE_H
@@ -0,0 +1,104 @@
+#include "phaselock.h"
+#include "frametimer.h"
+#include "hdmi.h"
+#include "clock.h"
+
+// Usable fractional K range, matching the limits of the PLL solver
+#define K_MIN 0x0ccccccdUL // 0.05
+#define K_MAX 0xf3333333UL // 0.95
+
+static PhaseLockStatus status;
+static PhaseLoop loop;
+
+static uint32_t base_k;
+static uint32_t pll_m;
+static uint32_t current_k;
+static uint32_t last_core_count, last_hdmi_count;
+
+// The M register holds the high and low counts of the divider
+static uint32_t pll_m_value(uint32_t reg)
+{
+    return ((reg >> 8) & 0xff) + (reg & 0xff);
+}
+
+static void write_trim(int32_t ppb)
+{
+    // Slowing the clock by ppb lowers M + K by the same fraction
+    int64_t dk = ((int64_t)ppb * pll_m * 4294967296LL) / 1000000000;
+    int64_t k = (int64_t)base_k - dk;
+
+    if (k < K_MIN) k = K_MIN;
+    if (k > K_MAX) k = K_MAX;
+
+    if ((uint32_t)k != current_k)
+    {
+        current_k = k;
+        crt_set_pll_k(current_k);
+    }
+}
+
+void phase_lock_start(const ModeTiming *timing, uint16_t hdmi_frames)
+{
+    const VideoMode *mode = &timing->mode;
+
+    base_k = timing->pll.k;
+    current_k = base_k;
+    pll_m = pll_m_value(timing->pll.m);
+
+    uint32_t htotal = mode->hact + mode->hfp + mode->hs + mode->hbp;
+    uint32_t period_ticks = ((uint64_t)video_mode_pixels(mode) * CLOCK_REF_KHZ) / mode->khz;
+    uint32_t target_ticks = ((uint64_t)htotal * PHASE_LOCK_TARGET_LINES * CLOCK_REF_KHZ) / mode->khz;
+    phase_loop_init(&loop, period_ticks, period_ticks / hdmi_frames, target_ticks);
+
+    FrameStamp stamps[FRAME_NUM_SOURCES];
+    frame_timer_read(stamps);
+    last_core_count = stamps[FRAME_SRC_CORE].count;
+    last_hdmi_count = stamps[FRAME_SRC_HDMI].count;
+
+    status.enabled = true;
+    status.available = base_k >= K_MIN && base_k <= K_MAX;
+    status.locked = false;
+    status.error_ticks = 0;
+    status.trim_ppb = 0;
+}
+
+void phase_lock_stop()
+{
+    if (status.enabled && current_k != base_k)
+    {
+        current_k = base_k;
+        crt_set_pll_k(base_k);
+    }
+
+    status.enabled = false;
+    status.locked = false;
+}
+
+void phase_lock_update()
+{
+    if (!status.enabled || !status.available) return;
+
+    FrameStamp stamps[FRAME_NUM_SOURCES];
+    frame_timer_read(stamps);
+
+    const FrameStamp *core = &stamps[FRAME_SRC_CORE];
+    const FrameStamp *hdmi = &stamps[FRAME_SRC_HDMI];
+
+    // Only act on a new pair of frames. The main loop can take more than a
+    // frame to get here, the loop is told how many core frames have passed.
+    if (core->count == last_core_count || hdmi->count == last_hdmi_count) return;
+    uint32_t frames = core->count - last_core_count;
+    last_core_count = core->count;
+    last_hdmi_count = hdmi->count;
+
+    write_trim(phase_loop_update(&loop, core->last_ticks, hdmi->last_ticks, frames));
+
+    status.error_ticks = loop.error_ticks;
+    status.trim_ppb = loop.trim_ppb;
+    status.locked = loop.locked;
+}
+
+const PhaseLockStatus *phase_lock_status()
+{
+    return &status;
+}
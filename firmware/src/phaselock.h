@@ -0,0 +1,40 @@
+#if !defined( PHASELOCK_H )
+#define PHASELOCK_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "modecalc.h"
+#include "phaseloop.h"
+
+// Holds the HDMI frame start a fixed distance behind the core frame start by
+// trimming the core pixel clock, so the scaler runs with a constant minimal
+// buffer delay instead of one that wanders as the two clocks drift.
+
+// Target distance from the core to the HDMI frame start, in core lines
+#define PHASE_LOCK_TARGET_LINES 8
+
+typedef struct
+{
+    bool enabled;
+    bool available; // false when the core PLL has no usable fractional K
+    bool locked;
+
+    int32_t error_ticks; // latest phase error, positive when the HDMI frame is late
+    int32_t trim_ppb;    // current slow down of the core clock
+} PhaseLockStatus;
+
+// Starts locking to the core mode 'timing', which must be the one in use.
+// The HDMI output shows each core frame for 'hdmi_frames' frames.
+void phase_lock_start(const ModeTiming *timing, uint16_t hdmi_frames);
+
+// Stops locking and restores the nominal core clock
+void phase_lock_stop();
+
+// Call from the main loop, ideally every frame. Frames missed when drawing
+// is slow are counted, so the loop behaves the same either way.
+void phase_lock_update();
+
+const PhaseLockStatus *phase_lock_status();
+
+#endif // PHASELOCK_H
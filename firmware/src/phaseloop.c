@@ -0,0 +1,76 @@
+#include "phaseloop.h"
+
+// The proportional gain is the fraction of the phase error corrected per
+// frame. The frequency difference between the clocks is learned separately,
+// from how fast the error moves under the trim, so the phase settles without
+// an integral of the error winding up and overshooting.
+#define GAIN_P_SHIFT 5
+#define GAIN_F_SHIFT 4
+
+// Frames one update can stand for. A trim held this long corrects at most
+// half of the error, so a stalled update cannot overshoot.
+#define MAX_UPDATE_FRAMES (1 << (GAIN_P_SHIFT - 1))
+
+void phase_loop_init(PhaseLoop *loop, uint32_t period_ticks, uint32_t hdmi_period_ticks, uint32_t target_ticks)
+{
+    loop->period_ticks = period_ticks;
+    loop->hdmi_period_ticks = hdmi_period_ticks;
+    loop->target_ticks = target_ticks;
+
+    loop->freq_ppb = 0;
+    loop->primed = false;
+    loop->locked_frames = 0;
+
+    loop->error_ticks = 0;
+    loop->trim_ppb = 0;
+    loop->locked = false;
+}
+
+int32_t phase_loop_update(PhaseLoop *loop, uint32_t core_ticks, uint32_t hdmi_ticks, uint32_t frames)
+{
+    int32_t hdmi_period = loop->hdmi_period_ticks;
+
+    // Distance from the core frame start to the following HDMI frame start
+    int32_t offset = (int32_t)(hdmi_ticks - core_ticks) % hdmi_period;
+    if (offset < 0) offset += hdmi_period;
+
+    int32_t error = offset - loop->target_ticks;
+    if (error >= hdmi_period / 2) error -= hdmi_period;
+    if (error < -(hdmi_period / 2)) error += hdmi_period;
+
+    if (frames == 0) frames = 1;
+    if (frames > MAX_UPDATE_FRAMES) frames = MAX_UPDATE_FRAMES;
+
+    // Correcting 'error' ticks over n frames needs a trim of error / (n * period)
+    int32_t ppb_per_tick = 1000000000 / loop->period_ticks;
+
+    // The error moves by the difference between the trim and the clock
+    // mismatch, so the mismatch is the trim plus the drift per frame
+    int32_t drift = error - loop->error_ticks;
+    if (loop->primed && drift < hdmi_period / 4 && drift > -(hdmi_period / 4))
+    {
+        int32_t freq_ppb = loop->trim_ppb + ((drift * ppb_per_tick) / (int32_t)frames);
+        if (freq_ppb > PHASE_LOCK_MAX_PPB) freq_ppb = PHASE_LOCK_MAX_PPB;
+        if (freq_ppb < -PHASE_LOCK_MAX_PPB) freq_ppb = -PHASE_LOCK_MAX_PPB;
+
+        loop->freq_ppb += (freq_ppb - loop->freq_ppb) >> GAIN_F_SHIFT;
+    }
+    loop->primed = true;
+
+    // The proportional trim acts for every frame until the next update
+    int32_t ppb = loop->freq_ppb + ((error * ppb_per_tick) >> GAIN_P_SHIFT);
+    if (ppb > PHASE_LOCK_MAX_PPB) ppb = PHASE_LOCK_MAX_PPB;
+    if (ppb < -PHASE_LOCK_MAX_PPB) ppb = -PHASE_LOCK_MAX_PPB;
+
+    uint32_t abs_error = error < 0 ? -error : error;
+    if (abs_error > PHASE_LOCK_LOCK_TICKS)
+        loop->locked_frames = 0;
+    else if (loop->locked_frames < PHASE_LOCK_LOCK_FRAMES)
+        loop->locked_frames += frames;
+
+    loop->error_ticks = error;
+    loop->trim_ppb = ppb;
+    loop->locked = loop->locked_frames >= PHASE_LOCK_LOCK_FRAMES;
+
+    return ppb;
+}
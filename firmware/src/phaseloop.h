@@ -0,0 +1,40 @@
+#if !defined( PHASELOOP_H )
+#define PHASELOOP_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The PI control loop of the phase lock. This has no hardware dependencies so
+// it is also built on the host by the phasemodel tool, which runs it against
+// simulated clocks.
+
+// Largest trim applied to the core clock
+#define PHASE_LOCK_MAX_PPB 2000000
+
+// Error that counts as locked, and for how many frames
+#define PHASE_LOCK_LOCK_TICKS 20 // 2us
+#define PHASE_LOCK_LOCK_FRAMES 60
+
+typedef struct
+{
+    uint32_t period_ticks;      // core frame
+    uint32_t hdmi_period_ticks;
+    uint32_t target_ticks;      // core to HDMI frame start distance to hold
+
+    int32_t freq_ppb; // learned clock mismatch, the trim that holds the phase still
+    bool primed;      // error_ticks and trim_ppb hold a previous update
+    uint16_t locked_frames;
+
+    int32_t error_ticks; // latest phase error, positive when the HDMI frame is late
+    int32_t trim_ppb;    // current slow down of the core clock
+    bool locked;
+} PhaseLoop;
+
+void phase_loop_init(PhaseLoop *loop, uint32_t period_ticks, uint32_t hdmi_period_ticks, uint32_t target_ticks);
+
+// Takes the latest core and HDMI frame starts, 'frames' core frames after the
+// previous update, and returns the new trim. The gains are per frame, so the
+// dynamics do not depend on how often this runs.
+int32_t phase_loop_update(PhaseLoop *loop, uint32_t core_ticks, uint32_t hdmi_ticks, uint32_t frames);
+
+#endif // PHASELOOP_H
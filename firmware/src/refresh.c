@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "frametimer.h"
+#include "phaselock.h"
+#include "refresh.h"
+#include "main.h"
+
+// Refresh diagnostics measures the true refresh rate of the core video and
+// the HDMI output from hardware frame timestamps, averaged over a window that
+// runs from when the screen was opened.
+typedef struct
+{
+    FrameWindow window[FRAME_NUM_SOURCES];
+} RefreshDiag;
+
+static RefreshDiag refresh_diag;
+
+void refresh_diag_start()
+{
+    FrameStamp stamps[FRAME_NUM_SOURCES];
+    frame_timer_read(stamps);
+    frame_timer_clear_periods();
+
+    for (int i = 0; i < FRAME_NUM_SOURCES; i++)
+    {
+        frame_window_start(&refresh_diag.window[i], &stamps[i]);
+    }
+}
+
+// "+12.3" from tenths
+static void format_signed_x10(char *str, int len, int32_t v)
+{
+    uint32_t a = v < 0 ? -v : v;
+    snprintf(str, len, "%c%u.%u", v < 0 ? '-' : '+', a / 10, a % 10);
+}
+
+static void draw_refresh_source(const char *name, const FrameWindow *window, const FrameStamp *cur, uint32_t nominal_uhz)
+{
+    uint32_t uhz = frame_window_uhz(window);
+
+    gfx_pen(TEXT_GRAY);
+    if (uhz == 0)
+    {
+        gfx_textf("%s: -", name);
+        gfx_newline(1);
+        return;
+    }
+
+    gfx_textf("%s: %u.%06u Hz", name, uhz / 1000000, uhz % 1000000);
+
+    char ppm[12] = "";
+    if (nominal_uhz)
+    {
+        format_signed_x10(ppm, sizeof(ppm), frame_rate_ppm_x10(uhz, nominal_uhz));
+        strcpy(ppm + strlen(ppm), " ppm ");
+    }
+
+    if (cur->max_period >= cur->min_period)
+    {
+        uint32_t jitter = cur->max_period - cur->min_period;
+        gfx_textf("  %s%u.%u us p-p", ppm, jitter / 10, jitter % 10);
+    }
+    else
+    {
+        gfx_textf("  %s", ppm);
+    }
+}
+
+void draw_refresh()
+{
+    FrameStamp cur[FRAME_NUM_SOURCES];
+    frame_timer_read(cur);
+
+    // Drawn every frame, well within the wrap of the tick count
+    RefreshDiag *d = &refresh_diag;
+    for (int i = 0; i < FRAME_NUM_SOURCES; i++)
+    {
+        frame_window_update(&d->window[i], &cur[i]);
+    }
+
+    if ((input_pressed() & INPUT_OK) || d->window[FRAME_SRC_CORE].frames >= FRAME_MAX_WINDOW
+            || d->window[FRAME_SRC_HDMI].frames >= FRAME_MAX_WINDOW)
+    {
+        refresh_diag_start();
+        frame_timer_read(cur);
+    }
+
+    // The requested rate, the HDMI rate is unknown in the MiSTer default mode
+    uint32_t hdmi_nominal = applied_refresh_idx >= 0 ? hdmi_refresh_rates[applied_refresh_idx] * 1000 : 0;
+    uint32_t core_nominal = core_millihz * 1000;
+
+    gfx_clear();
+    gfx_pen(TEXT_BLUE);
+    gfx_begin_window(ALIGN_CENTER | ALIGN_MIDDLE, 0, 0, 30, 15, 1);
+    gfx_pen(TEXT_DARK_GRAY);
+    gfx_text_aligned(ALIGN_CENTER, "REFRESH DIAGNOSTICS");
+    gfx_newline(1);
+
+    draw_refresh_source("Core", &d->window[FRAME_SRC_CORE], &cur[FRAME_SRC_CORE], core_nominal);
+    draw_refresh_source("HDMI", &d->window[FRAME_SRC_HDMI], &cur[FRAME_SRC_HDMI], hdmi_nominal);
+
+    uint32_t core_uhz = frame_window_uhz(&d->window[FRAME_SRC_CORE]);
+    uint32_t hdmi_uhz = frame_window_uhz(&d->window[FRAME_SRC_HDMI]);
+
+    gfx_pen(TEXT_GRAY);
+    if (core_uhz && hdmi_uhz)
+    {
+        // How fast the HDMI frame start moves against the core frame start
+        char drift[12];
+        format_signed_x10(drift, sizeof(drift), frame_rate_ppm_x10(hdmi_uhz, core_uhz));
+        gfx_textf("Drift: %s us/s", drift);
+
+        // From the core frame start to the following HDMI frame start
+        uint32_t hdmi_period = (CLOCK_REF_HZ * 1000000ULL) / hdmi_uhz;
+        int32_t offset = (int32_t)(cur[FRAME_SRC_HDMI].last_ticks - cur[FRAME_SRC_CORE].last_ticks) % (int32_t)hdmi_period;
+        if (offset < 0) offset += hdmi_period;
+        char ms[CLOCK_MS_STR_LEN];
+        clock_ticks_to_ms_str(offset, ms);
+        gfx_textf("Offset: %s ms", ms);
+    }
+    else
+    {
+        gfx_text("Drift: -");
+        gfx_newline(1);
+    }
+
+    const PhaseLockStatus *lock = phase_lock_status();
+    if (!lock->enabled)
+    {
+        gfx_text("Lock: off");
+    }
+    else if (!lock->available)
+    {
+        gfx_text("Lock: not available");
+    }
+    else
+    {
+        char trim[12];
+        format_signed_x10(trim, sizeof(trim), -(lock->trim_ppb / 100));
+        gfx_textf("Lock: %s %s ppm", lock->locked ? "locked" : "pulling in", trim);
+    }
+
+    uint32_t window_s = d->window[FRAME_SRC_CORE].span_ticks / CLOCK_REF_HZ;
+    gfx_textf("Window: %u s", window_s);
+
+    gfx_newline(1);
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("A to restart, B to exit.");
+    gfx_end_window();
+}
@@ -0,0 +1,10 @@
+#if !defined( REFRESH_H )
+#define REFRESH_H 1
+
+// Refresh diagnostics screen, which shows the measured core and HDMI refresh
+// rates, the drift between them and the state of the phase lock
+
+void refresh_diag_start();
+void draw_refresh();
+
+#endif // REFRESH_H
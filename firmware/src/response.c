@@ -0,0 +1,101 @@
+#include "response.h"
+
+// Samples are smoothed with a 4 tap box filter before looking for crossings,
+// the filtered value at i is centered on i + 1.5
+#define SMOOTH_TAPS 4
+#define SMOOTH_DELAY ((3 << RESPONSE_FRAC_BITS) / 2)
+
+static int32_t smoothed(const uint16_t *samples, uint16_t i)
+{
+    return samples[i] + samples[i + 1] + samples[i + 2] + samples[i + 3];
+}
+
+// Finds the first smoothed sample at or beyond 'level' from 'from' onwards and
+// interpolates the crossing time. Returns false if it is never reached.
+static bool find_crossing(const uint16_t *samples, uint16_t count, uint16_t from, int32_t level, bool rising, uint32_t *t, uint16_t *index)
+{
+    int32_t prev = smoothed(samples, from);
+
+    for (uint16_t i = from + 1; i + SMOOTH_TAPS <= count; i++)
+    {
+        int32_t cur = smoothed(samples, i);
+        bool crossed = rising ? (cur >= level && prev < level) : (cur <= level && prev > level);
+
+        if (crossed)
+        {
+            // Both differences have the same sign whichever way the step goes
+            int32_t frac = ((level - prev) << RESPONSE_FRAC_BITS) / (cur - prev);
+
+            *t = ((uint32_t)(i - 1) << RESPONSE_FRAC_BITS) + frac + SMOOTH_DELAY;
+            *index = i;
+            return true;
+        }
+
+        prev = cur;
+    }
+
+    return false;
+}
+
+bool response_analyze(const uint16_t *samples, uint16_t count, uint16_t pre, StepResponse *r)
+{
+    uint16_t settle = count / 16;
+    if (settle < 4 || pre + settle + SMOOTH_TAPS > count) return false;
+
+    uint16_t base = pre >= RESPONSE_MIN_PRE ? pre : settle;
+
+    uint32_t start_sum = 0, end_sum = 0;
+    for (uint16_t i = 0; i < base; i++)
+    {
+        start_sum += samples[i];
+    }
+    for (uint16_t i = 0; i < settle; i++)
+    {
+        end_sum += samples[count - settle + i];
+    }
+
+    int32_t start_level = start_sum / base;
+    int32_t end_level = end_sum / settle;
+    int32_t step = end_level - start_level;
+
+    // Noise is the mean deviation of the initial settled level
+    uint32_t noise = 0;
+    for (uint16_t i = 0; i < base; i++)
+    {
+        int32_t d = samples[i] - start_level;
+        noise += d < 0 ? -d : d;
+    }
+    noise = (noise / base) + 1;
+
+    uint32_t step_size = step < 0 ? -step : step;
+    if (step_size < (noise * 8)) return false;
+
+    r->rising = step > 0;
+    r->start_level = start_level;
+    r->end_level = end_level;
+
+    // Levels in smoothed units, 4 samples summed
+    int32_t level10 = (start_level * SMOOTH_TAPS) + ((step * SMOOTH_TAPS) / 10);
+    int32_t level90 = (start_level * SMOOTH_TAPS) + ((step * SMOOTH_TAPS * 9) / 10);
+
+    uint16_t i10, i90;
+    if (!find_crossing(samples, count, pre, level10, r->rising, &r->t10, &i10)) return false;
+    if (!find_crossing(samples, count, i10 - 1, level90, r->rising, &r->t90, &i90)) return false;
+
+    int32_t peak = end_level * SMOOTH_TAPS;
+    for (uint16_t i = i90; i + SMOOTH_TAPS <= count; i++)
+    {
+        int32_t v = smoothed(samples, i);
+        if (r->rising ? v > peak : v < peak) peak = v;
+    }
+
+    int32_t over = peak - (end_level * SMOOTH_TAPS);
+    if (over < 0) over = -over;
+    r->overshoot_permille = (over * 1000) / (step_size * SMOOTH_TAPS);
+
+    // Times from the stimulus
+    r->t10 -= (uint32_t)pre << RESPONSE_FRAC_BITS;
+    r->t90 -= (uint32_t)pre << RESPONSE_FRAC_BITS;
+
+    return true;
+}
@@ -0,0 +1,43 @@
+#if !defined(RESPONSE_H)
+#define RESPONSE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Step response analysis of analog sensor samples. This has no hardware
+// dependencies so it is also built on the host by the analyze tool, which
+// runs it over recorded sample files.
+
+// Times are in samples with this many fractional bits
+#define RESPONSE_FRAC_BITS 8
+
+// Fewest samples from before the stimulus that are used as the start level
+#define RESPONSE_MIN_PRE 16
+
+typedef struct
+{
+    bool rising;
+
+    uint16_t start_level; // settled level before the step
+    uint16_t end_level;   // settled level after the step
+
+    uint32_t t10;         // time the step passed 10%, measured from sample 'pre', the stimulus
+    uint32_t t90;         // time the step passed 90%
+
+    uint16_t overshoot_permille; // peak beyond end_level relative to the step size
+} StepResponse;
+
+// Finds the single transition in 'samples' and measures its 10% to 90% time.
+// The first 'pre' samples were taken before the stimulus and give the settled
+// start level, the last sixteenth of the buffer gives the end level. Without
+// at least RESPONSE_MIN_PRE of them the first sixteenth is taken instead,
+// which is only right when the step starts well after it. Returns false when
+// there is no step clearly larger than the noise, or it begins before 'pre'.
+bool response_analyze(const uint16_t *samples, uint16_t count, uint16_t pre, StepResponse *r);
+
+static inline uint32_t response_time(const StepResponse *r)
+{
+    return r->t90 - r->t10;
+}
+
+#endif // RESPONSE_H
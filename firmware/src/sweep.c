@@ -0,0 +1,614 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "printf/printf.h"
+
+#include "util.h"
+#include "interrupts.h"
+#include "hdmi.h"
+#include "phaselock.h"
+#include "sweep.h"
+#include "main.h"
+
+// A sweep applies each selected video mode in turn, waits for the display to
+// resync and then collects a fixed number of samples, showing a table of the
+// results at the end. Sweeping everything can select more modes than there
+// is room for, the rest are left out.
+#define SWEEP_MAX_RESULTS 512
+#define SWEEP_PAGE_ROWS 20
+
+// Statistics for one video mode of a sweep
+typedef struct
+{
+    uint8_t mode_idx;
+    uint8_t refresh_idx;
+    uint8_t blanking;
+    uint8_t core;
+    LatencyStats stats;
+} SweepResult;
+
+typedef struct
+{
+    SweepPhase phase;
+
+    // Mode selected in the config menu
+    int mode_idx;
+    int refresh_idx;
+    int aspect_idx;
+    int core_idx;
+    Blanking blanking;
+
+    // Setup options
+    int type_idx;
+    int all_modes;
+    int all_refresh;
+    int all_blanking;
+    int all_core;
+    int samples_idx;
+
+    uint16_t num_results;
+    uint16_t current;
+    uint16_t scroll;
+    bool aborted;
+    bool truncated;
+
+    SweepResult results[SWEEP_MAX_RESULTS];
+} Sweep;
+
+static Sweep sweep;
+
+SweepPhase sweep_phase()
+{
+    return sweep.phase;
+}
+
+static const char *sweep_sample_options[3] = { "8", "16", "32" };
+static const uint16_t sweep_sample_counts[3] = { 8, 16, 32 };
+
+enum { SWEEP_TYPE_MODES, SWEEP_TYPE_VRR };
+static const char *sweep_types[2] = { "Modes", "VRR" };
+
+void sweep_select(int mode_idx, int refresh_idx, int aspect_idx, int core_idx, const Blanking *blanking)
+{
+    sweep.mode_idx = mode_idx;
+    sweep.refresh_idx = refresh_idx;
+    sweep.aspect_idx = aspect_idx;
+    sweep.core_idx = core_idx;
+    sweep.blanking = *blanking;
+    sweep.phase = SWEEP_SETUP;
+}
+
+// Every blanking type uses the minimal blanking sizes selected in the menu
+static void sweep_blanking(uint8_t type, Blanking *blanking)
+{
+    *blanking = sweep.blanking;
+    blanking->type = type;
+}
+
+static void sweep_apply_current()
+{
+    const SweepResult *r = &sweep.results[sweep.current];
+    Blanking blanking;
+    sweep_blanking(r->blanking, &blanking);
+    apply_video_mode(r->mode_idx, r->refresh_idx, sweep.aspect_idx, r->core, &blanking);
+    sweep.phase = SWEEP_SETTLE;
+}
+
+static void vrr_stop();
+
+static void sweep_end(bool aborted)
+{
+    disable_interrupts();
+    sample_stats = NULL;
+    enable_interrupts();
+
+    if (sweep.type_idx == SWEEP_TYPE_VRR) vrr_stop();
+
+    sweep.aborted = aborted;
+    sweep.phase = SWEEP_SUMMARY;
+}
+
+static void sweep_begin()
+{
+    sweep.num_results = 0;
+    sweep.truncated = false;
+    for (int m = 0; m < NUM_HDMI_RESOLUTIONS; m++)
+    {
+        if (!sweep.all_modes && m != sweep.mode_idx) continue;
+
+        for (int f = 0; f < NUM_HDMI_REFRESH_RATES; f++)
+        {
+            if (!sweep.all_refresh && f != sweep.refresh_idx) continue;
+
+            for (int b = 0; b < NUM_BLANKING; b++)
+            {
+                if (!sweep.all_blanking && b != (int)sweep.blanking.type) continue;
+
+                Blanking blanking;
+                sweep_blanking(b, &blanking);
+                if (!video_mode_available(m, f, &blanking)) continue;
+
+                // Every core format the resolution has, native is not always available
+                for (int c = 0; c < NUM_CORE_FORMATS; c++)
+                {
+                    if (!core_format_available(m, c)) continue;
+                    if (!sweep.all_core && c != sweep.core_idx) continue;
+                    if (sweep.num_results == SWEEP_MAX_RESULTS)
+                    {
+                        sweep.truncated = true;
+                        continue;
+                    }
+
+                    SweepResult *r = &sweep.results[sweep.num_results++];
+                    memset(r, 0, sizeof(SweepResult));
+                    r->mode_idx = m;
+                    r->refresh_idx = f;
+                    r->blanking = b;
+                    r->core = c;
+                }
+            }
+        }
+    }
+
+    sweep.current = 0;
+    sweep.scroll = 0;
+    sweep.aborted = false;
+
+    if (sweep.num_results == 0)
+        sweep_end(false);
+    else
+        sweep_apply_current();
+}
+
+// A VRR sweep keeps the current video mode and varies the core frame time
+// instead, by adding lines to the vertical front porch from the vblank
+// interrupt. The range from the mode's own frame time up to that of the
+// lowest refresh rate is split into VRR_STEPS frame times. Stepping holds
+// each frame time until its samples are in, walking moves up or down one step
+// at random every frame. Either way each sample is filed under the frame time
+// just before the patch appeared, and the sweep ends once every step has its
+// samples.
+#define VRR_STEPS 8
+
+enum { VRR_STEP, VRR_WALK };
+static const char *vrr_patterns[2] = { "Step", "Walk" };
+static const char *vrr_min_rate_options[4] = { "48Hz", "40Hz", "30Hz", "24Hz" };
+static const uint32_t vrr_min_rates[4] = { 48000, 40000, 30000, 24000 };
+
+typedef struct
+{
+    int pattern_idx;
+    int min_rate_idx;
+
+    uint16_t samples;
+    uint32_t base_ticks;
+    uint32_t line_ticks;
+    uint16_t max_lines;
+
+    // Step being held by the step pattern
+    volatile uint8_t step;
+
+    LatencyStats results[VRR_STEPS];
+} Vrr;
+
+static Vrr vrr;
+
+volatile bool vrr_running = false;
+
+// Steps of the front porch being output and of the one written for the next
+// frame, -1 until set
+static volatile int8_t vrr_cur_step = -1;
+static volatile int8_t vrr_next_step = -1;
+
+static uint16_t vrr_step_lines(int step)
+{
+    return ((uint32_t)vrr.max_lines * step) / (VRR_STEPS - 1);
+}
+
+static uint32_t vrr_step_ticks(int step)
+{
+    return vrr.base_ticks + (vrr.line_ticks * vrr_step_lines(step));
+}
+
+static bool vrr_step_done(int step)
+{
+    const LatencyStats *s = &vrr.results[step];
+    return s->count >= vrr.samples || s->missing >= vrr.samples;
+}
+
+// Works out the frame times for the current core timing, false if it already
+// runs at or below the lowest refresh rate
+static bool vrr_calc_range()
+{
+    const VideoMode *mode = &core_timing->mode;
+    uint32_t htotal = mode->hact + mode->hfp + mode->hs + mode->hbp;
+    uint32_t max_ticks = ((uint64_t)CLOCK_REF_KHZ * 1000000) / vrr_min_rates[vrr.min_rate_idx];
+
+    vrr.line_ticks = ((uint64_t)htotal * CLOCK_REF_KHZ) / mode->khz;
+    vrr.base_ticks = ((uint64_t)video_mode_pixels(mode) * CLOCK_REF_KHZ) / mode->khz;
+    if (vrr.base_ticks >= max_ticks) return false;
+
+    uint32_t lines = (max_ticks - vrr.base_ticks) / vrr.line_ticks;
+    if (lines > crt_max_vfp_extra()) lines = crt_max_vfp_extra();
+    vrr.max_lines = lines;
+    return lines >= VRR_STEPS;
+}
+
+// Runs from the vblank interrupt, the front porch written here is used by the
+// next frame
+void vrr_frame()
+{
+    int step = vrr.step;
+
+    if (vrr.pattern_idx == VRR_WALK && vrr_next_step >= 0)
+    {
+        step = vrr_next_step + (int)(rand32() % 3) - 1;
+        if (step < 0) step = 1;
+        if (step >= VRR_STEPS) step = VRR_STEPS - 2;
+    }
+
+    vrr_cur_step = vrr_next_step;
+    vrr_next_step = step;
+    crt_set_vfp_extra(vrr_step_lines(step));
+}
+
+LatencyStats *vrr_frame_stats()
+{
+    int step = vrr_cur_step;
+    if (step < 0 || vrr_step_done(step)) return NULL;
+    return &vrr.results[step];
+}
+
+static void vrr_begin()
+{
+    memset(vrr.results, 0, sizeof(vrr.results));
+    vrr.samples = sweep_sample_counts[sweep.samples_idx];
+    vrr.step = 0;
+    sweep.aborted = false;
+
+    if (!vrr_calc_range())
+    {
+        sweep_end(false);
+        return;
+    }
+
+    // Phase lock would fight the changing frame time
+    phase_lock_stop();
+
+    disable_interrupts();
+    vrr_cur_step = -1;
+    vrr_next_step = -1;
+    vrr_running = true;
+    set_state(ST_CLEAR);
+    enable_interrupts();
+
+    sweep.phase = SWEEP_SAMPLE;
+}
+
+static void vrr_stop()
+{
+    disable_interrupts();
+    vrr_running = false;
+    sample_stats = NULL;
+    crt_set_vfp_extra(0);
+    enable_interrupts();
+
+    if (phase_lock_on) phase_lock_start(core_timing, core_hdmi_frames);
+}
+
+static void vrr_update()
+{
+    if (vrr.pattern_idx == VRR_STEP)
+    {
+        // The interrupt reads the step, so it never goes past the last one
+        int step = vrr.step;
+        while (step < VRR_STEPS && vrr_step_done(step)) step++;
+        if (step < VRR_STEPS)
+        {
+            vrr.step = step;
+            return;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < VRR_STEPS; i++)
+        {
+            if (!vrr_step_done(i)) return;
+        }
+    }
+
+    sweep_end(false);
+}
+
+// Runs the sweep, called once per frame
+static void sweep_update()
+{
+    uint16_t samples = sweep_sample_counts[sweep.samples_idx];
+
+    if (sweep.type_idx == SWEEP_TYPE_VRR)
+    {
+        if (sweep.phase == SWEEP_SAMPLE) vrr_update();
+        return;
+    }
+
+    if (sweep.phase == SWEEP_SETTLE)
+    {
+        if (!settle_active())
+        {
+            disable_interrupts();
+            set_state(ST_CLEAR);
+            sample_stats = &sweep.results[sweep.current].stats;
+            enable_interrupts();
+            sweep.phase = SWEEP_SAMPLE;
+        }
+    }
+    else if (sweep.phase == SWEEP_SAMPLE)
+    {
+        const SweepResult *r = &sweep.results[sweep.current];
+
+        // Give up on a mode once as many samples are missing as were asked for
+        if (r->stats.count >= samples || r->stats.missing >= samples)
+        {
+            disable_interrupts();
+            sample_stats = NULL;
+            enable_interrupts();
+
+            sweep.current++;
+            if (sweep.current == sweep.num_results)
+                sweep_end(false);
+            else
+                sweep_apply_current();
+        }
+    }
+}
+
+static void draw_sweep_progress()
+{
+    const SweepResult *r = &sweep.results[sweep.current];
+
+    gfx_begin_window(ALIGN_BOTTOM | align_info(), 2, 8, 24, 2, 0);
+    gfx_pen(TEXT_YELLOW);
+    if (sweep.type_idx == SWEEP_TYPE_VRR)
+    {
+        if (vrr.pattern_idx == VRR_STEP)
+        {
+            gfx_textf("VRR %u/%u: %u/%u", vrr.step + 1, VRR_STEPS, vrr.results[vrr.step].count, vrr.samples);
+        }
+        else
+        {
+            int done = 0;
+            for (int i = 0; i < VRR_STEPS; i++) done += vrr_step_done(i) ? 1 : 0;
+            gfx_textf("VRR walk: %u/%u steps", done, VRR_STEPS);
+        }
+    }
+    else if (sweep.phase == SWEEP_SETTLE)
+    {
+        gfx_textf("Sweep %u/%u: resyncing", sweep.current + 1, sweep.num_results);
+    }
+    else
+    {
+        gfx_textf("Sweep %u/%u: %u/%u", sweep.current + 1, sweep.num_results,
+                    r->stats.count, sweep_sample_counts[sweep.samples_idx]);
+    }
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("Press START to stop.");
+    gfx_end_window();
+}
+
+static void draw_sweep_summary()
+{
+    uint16_t pressed = input_pressed();
+    if ((pressed & INPUT_DOWN) && sweep.scroll + SWEEP_PAGE_ROWS < sweep.num_results) sweep.scroll += SWEEP_PAGE_ROWS;
+    if ((pressed & INPUT_UP) && sweep.scroll >= SWEEP_PAGE_ROWS) sweep.scroll -= SWEEP_PAGE_ROWS;
+
+    gfx_clear();
+    gfx_pen(TEXT_BLUE);
+    gfx_begin_window(ALIGN_CENTER | ALIGN_MIDDLE, 0, 0, 40, SWEEP_PAGE_ROWS + 6, 1);
+
+    gfx_pen(TEXT_DARK_GRAY);
+    if (sweep.aborted)
+        gfx_text_aligned(ALIGN_CENTER, "SWEEP RESULTS (STOPPED)");
+    else if (sweep.truncated)
+        gfx_text_aligned(ALIGN_CENTER, "SWEEP RESULTS (PARTIAL)");
+    else
+        gfx_text_aligned(ALIGN_CENTER, "SWEEP RESULTS");
+    gfx_pen(TEXT_BLUE);
+    gfx_text("Mode                   Avg   Min   Max");
+
+    uint16_t end = sweep.scroll + SWEEP_PAGE_ROWS;
+    if (end > sweep.num_results) end = sweep.num_results;
+
+    for (uint16_t i = sweep.scroll; i < end; i++)
+    {
+        const SweepResult *r = &sweep.results[i];
+        char name[24];
+        snprintf(name, sizeof(name), "%ux%u@%s", hdmi_resolutions[r->mode_idx].width,
+                    hdmi_resolutions[r->mode_idx].height, refresh_to_string(hdmi_refresh_rates, r->refresh_idx));
+        name[strlen(name) - 2] = '\0'; // drop "hz"
+
+        // The core format, with the blanking initial when both differ from the default
+        char tag[6];
+        if (r->core == CORE_240P)
+            strcpy(tag, blanking_tags[r->blanking]);
+        else if (r->blanking == BLANKING_STANDARD)
+            strcpy(tag, core_video_tags[r->core]);
+        else
+            snprintf(tag, sizeof(tag), "%s%c", core_video_tags[r->core], blanking_tags[r->blanking][0]);
+
+        if (r->stats.count == 0)
+        {
+            gfx_pen(TEXT_RED);
+            gfx_textf("%-15.15s%5s %s", name, tag, (sweep.aborted && i >= sweep.current) ? "-" : "no samples");
+            continue;
+        }
+
+        char avg[CLOCK_MS_STR_LEN], min[CLOCK_MS_STR_LEN], max[CLOCK_MS_STR_LEN];
+        stats_to_ms(&r->stats, avg, min, max);
+
+        // Modes that dropped samples are highlighted
+        gfx_pen(r->stats.missing ? TEXT_ORANGE : TEXT_GRAY);
+        gfx_textf("%-15.15s%5s%6s%6s%6s", name, tag, avg, min, max);
+    }
+
+    gfx_newline(1 + SWEEP_PAGE_ROWS - (end - sweep.scroll));
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("Up/Down to scroll, B to exit.");
+    gfx_end_window();
+}
+
+// "16.67" ms and "60.0" Hz for a frame time in ticks, hz holds 8 chars
+static void format_frame_time(uint32_t ticks, char *ms, char *hz)
+{
+    clock_ticks_to_ms_str(ticks, ms);
+    ms[strlen(ms) - 1] = '\0';
+
+    uint32_t hz_x10 = ((uint64_t)CLOCK_REF_KHZ * 10000) / ticks;
+    snprintf(hz, 8, "%u.%u", hz_x10 / 10, hz_x10 % 10);
+}
+
+static void draw_vrr_summary()
+{
+    gfx_clear();
+    gfx_pen(TEXT_BLUE);
+    gfx_begin_window(ALIGN_CENTER | ALIGN_MIDDLE, 0, 0, 40, VRR_STEPS + 6, 1);
+
+    gfx_pen(TEXT_DARK_GRAY);
+    gfx_text_aligned(ALIGN_CENTER, sweep.aborted ? "VRR RESULTS (STOPPED)" : "VRR RESULTS");
+    gfx_pen(TEXT_BLUE);
+    gfx_text("Frame ms    Hz   Avg   Min   Max");
+
+    for (int i = 0; i < VRR_STEPS; i++)
+    {
+        const LatencyStats *s = &vrr.results[i];
+        char frame[CLOCK_MS_STR_LEN], hz[8];
+        format_frame_time(vrr_step_ticks(i), frame, hz);
+
+        if (s->count == 0)
+        {
+            gfx_pen(TEXT_RED);
+            gfx_textf("%8s%6s %s", frame, hz, sweep.aborted ? "-" : "no samples");
+            continue;
+        }
+
+        char avg[CLOCK_MS_STR_LEN], min[CLOCK_MS_STR_LEN], max[CLOCK_MS_STR_LEN];
+        stats_to_ms(s, avg, min, max);
+
+        gfx_pen(s->missing ? TEXT_ORANGE : TEXT_GRAY);
+        gfx_textf("%8s%6s%6s%6s%6s", frame, hz, avg, min, max);
+    }
+
+    gfx_newline(1);
+    gfx_pen(TEXT_DARK_BLUE);
+    gfx_text("Press B to exit.");
+    gfx_end_window();
+}
+
+// Returns false when the sweep screens are closed
+bool draw_sweep(bool reset)
+{
+    static MenuContext menuctx = INIT_MENU_CONTEXT;
+
+    if (reset)
+    {
+        sweep.phase = SWEEP_SETUP;
+    }
+
+    if (sweep.phase == SWEEP_SETUP)
+    {
+        gfx_clear();
+        gfx_begin_menu("MODE SWEEP", 28, 23, &menuctx);
+
+        gfx_menuitem_select("Sweep", sweep_types, 2, &sweep.type_idx);
+
+        if (sweep.type_idx == SWEEP_TYPE_VRR)
+        {
+            gfx_menuitem_select("Pattern", vrr_patterns, 2, &vrr.pattern_idx);
+            gfx_menuitem_select("Lowest Rate", vrr_min_rate_options, 4, &vrr.min_rate_idx);
+            gfx_menuitem_select("Samples", sweep_sample_options, 3, &sweep.samples_idx);
+            gfx_newline(4);
+
+            gfx_newline(1);
+            bool available = vrr_calc_range();
+            if (!available)
+            {
+                gfx_newline(1);
+                gfx_pen(TEXT_DARK_GRAY);
+                gfx_text_aligned(ALIGN_CENTER, "Range Unavailable");
+            }
+            else if (gfx_menuitem_button("Start VRR Sweep"))
+            {
+                vrr_begin();
+            }
+
+            gfx_newline(1);
+            gfx_pen(TEXT_GRAY);
+            gfx_textf("Mode: %.20s", video_mode_desc);
+            if (available)
+            {
+                char min_ms[CLOCK_MS_STR_LEN], max_ms[CLOCK_MS_STR_LEN], hz[8];
+                format_frame_time(vrr_step_ticks(0), min_ms, hz);
+                format_frame_time(vrr_step_ticks(VRR_STEPS - 1), max_ms, hz);
+                gfx_textf("Frames: %s to %s ms", min_ms, max_ms);
+            }
+            gfx_end_menu();
+
+            return (input_pressed() & (INPUT_MENU | INPUT_BACK)) == 0;
+        }
+
+        const char *scope[2] = { "Selected", "All" };
+        gfx_menuitem_select("Resolutions", scope, 2, &sweep.all_modes);
+        gfx_menuitem_select("Refresh Rates", scope, 2, &sweep.all_refresh);
+        gfx_menuitem_select("Blanking", scope, 2, &sweep.all_blanking);
+        gfx_menuitem_select("Core Video", scope, 2, &sweep.all_core);
+        gfx_menuitem_select("Samples", sweep_sample_options, 3, &sweep.samples_idx);
+
+        gfx_newline(1);
+        if (gfx_menuitem_button("Start Sweep"))
+        {
+            sweep_begin();
+        }
+
+        gfx_newline(1);
+        gfx_pen(TEXT_GRAY);
+        gfx_textf("Selected: %s", resolution_to_string(hdmi_resolutions, sweep.mode_idx));
+        gfx_textf("          %s", refresh_to_string(hdmi_refresh_rates, sweep.refresh_idx));
+        if (sweep.blanking.type == BLANKING_MINIMAL)
+        {
+            gfx_textf("          %s %ux%u", blanking_names[sweep.blanking.type], sweep.blanking.hblank, sweep.blanking.vblank);
+        }
+        else
+        {
+            gfx_textf("          %s", blanking_names[sweep.blanking.type]);
+        }
+        gfx_textf("          %s core", core_video_names[sweep.core_idx]);
+        gfx_end_menu();
+
+        return (input_pressed() & (INPUT_MENU | INPUT_BACK)) == 0;
+    }
+
+    if (sweep.phase == SWEEP_SUMMARY)
+    {
+        if (sweep.type_idx == SWEEP_TYPE_VRR)
+            draw_vrr_summary();
+        else
+            draw_sweep_summary();
+        return (input_pressed() & (INPUT_MENU | INPUT_BACK)) == 0;
+    }
+
+    sweep_update();
+
+    if (sweep.phase == SWEEP_SUMMARY)
+    {
+        return true;
+    }
+
+    if (input_pressed() & INPUT_MENU)
+    {
+        sweep_end(true);
+        return true;
+    }
+
+    draw_sampling();
+    draw_sweep_progress();
+
+    return true;
+}
@@ -0,0 +1,31 @@
+#if !defined( SWEEP_H )
+#define SWEEP_H 1
+
+#include <stdbool.h>
+
+#include "main.h"
+
+// Mode and VRR sweep screens. A mode sweep samples the latency of each
+// selected video mode in turn, a VRR sweep varies the core frame time of the
+// current one.
+
+typedef enum { SWEEP_SETUP, SWEEP_SETTLE, SWEEP_SAMPLE, SWEEP_SUMMARY } SweepPhase;
+
+// Set while a VRR sweep is varying the core frame time
+extern volatile bool vrr_running;
+
+// Modes selected in the config menu, the setup screen starts from these
+void sweep_select(int mode_idx, int refresh_idx, int aspect_idx, int core_idx, const Blanking *blanking);
+
+SweepPhase sweep_phase();
+
+// Returns false when the sweep screens are closed
+bool draw_sweep(bool reset);
+
+// Called from the vblank interrupt while vrr_running is set
+void vrr_frame();
+
+// Statistics for the frame time before the next patch, NULL if not wanted
+LatencyStats *vrr_frame_stats();
+
+#endif // SWEEP_H
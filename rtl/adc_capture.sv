@@ -0,0 +1,197 @@
+// Analog sensor capture
+//
+// Records samples from the ltc2308 ADC into a BRAM buffer. Every DIV + 1 ADC
+// samples are summed into one buffer entry, which both extends the capture and
+// averages out noise, so DIV must be 15 or less for the sum to fit in 16 bits.
+//
+// Once armed the buffer is written as a ring, so that up to PRE entries from
+// before the trigger are kept as a baseline. After the trigger the capture
+// carries on until the buffer is full. Fewer than PRE entries are kept if the
+// trigger comes too soon after arming, PRE_COUNT gives the number kept.
+//
+// Registers (word offsets, address[12] clear)
+//   0 CTRL      write bit 0 to arm or disarm, clears DONE
+//               read bit 0 ARMED, bit 1 RUNNING, bit 2 DONE
+//   1 DIV       ADC samples summed per entry, minus one
+//   2 PRE       entries to keep from before the trigger, at most 2047
+//   3 COUNT     entries written, valid once DONE
+//   4 TRIGGER   tick count at the trigger, high word
+//   5 TRIGGER   low word
+//   6 PRE_COUNT entries kept from before the trigger, valid once DONE
+// With address[12] set, address[11:0] reads an entry from the buffer, in the
+// order they were captured. Entry PRE_COUNT is the first after the trigger.
+//
+// DIV and PRE are used directly by the capture clock domain, only change them
+// while the unit is idle.
+
+module adc_capture(
+    input clk,
+    input reset,
+
+    input clk_50m,
+
+    input [11:0] adc_sample,
+    input adc_sync,
+
+    input trigger,
+    input [31:0] ticks,
+
+    input [1:0] wr,
+
+    input [12:0] address,
+    input [15:0] din,
+    output [15:0] dout,
+
+    output reg done
+);
+
+localparam ENTRIES_WIDTH = 12;
+
+localparam ENTRIES = 1 << ENTRIES_WIDTH;
+
+reg armed, run, active;
+reg [3:0] div;
+reg [10:0] pre;
+reg [31:0] trigger_ticks;
+reg [15:0] reg_dout;
+
+reg [1:0] full_sync;
+reg [ENTRIES_WIDTH:0] count;
+
+wire [15:0] buf_dout;
+assign dout = address[12] ? buf_dout : reg_dout;
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        armed <= 0;
+        run <= 0;
+        active <= 0;
+        done <= 0;
+        div <= 4'd4;
+        pre <= 11'd0;
+    end else begin
+        full_sync <= { full_sync[0], full };
+
+        if (armed & trigger) begin
+            armed <= 0;
+            run <= 1;
+            trigger_ticks <= ticks;
+        end
+
+        if (run & full_sync[1]) begin
+            run <= 0;
+            active <= 0;
+            done <= 1;
+            count <= ENTRIES[ENTRIES_WIDTH:0];
+        end
+
+        if (~address[12]) begin
+            case(address[2:0])
+            0: begin
+                if (wr[0]) begin
+                    armed <= din[0];
+                    active <= din[0];
+                    run <= 0;
+                    done <= 0;
+                end
+                reg_dout <= { 13'd0, done, run, armed };
+            end
+            1: begin
+                if (wr[0]) div <= din[3:0];
+                reg_dout <= { 12'd0, div };
+            end
+            2: begin
+                if (wr[0]) pre[7:0] <= din[7:0];
+                if (wr[1]) pre[10:8] <= din[10:8];
+                reg_dout <= { 5'd0, pre };
+            end
+            3: reg_dout <= { {(15 - ENTRIES_WIDTH){1'b0}}, count };
+            4: reg_dout <= trigger_ticks[31:16];
+            5: reg_dout <= trigger_ticks[15:0];
+            6: reg_dout <= { {(15 - ENTRIES_WIDTH){1'b0}}, pre_count };
+            default: reg_dout <= 16'd0;
+            endcase
+        end
+    end
+end
+
+// clk_50m domain
+reg [1:0] active_sync, run_sync;
+reg prev_adc_sync;
+reg started, triggered, full;
+reg [3:0] div_cnt;
+reg [15:0] sum;
+reg [ENTRIES_WIDTH-1:0] wptr;
+reg [ENTRIES_WIDTH:0] filled;     // entries written before the trigger, saturating
+reg [ENTRIES_WIDTH:0] pre_count;
+reg [ENTRIES_WIDTH-1:0] start_ptr; // buffer position of the first kept entry
+
+wire [ENTRIES_WIDTH:0] pre_keep = filled < pre ? filled : pre;
+
+reg buf_wr;
+reg [ENTRIES_WIDTH-1:0] buf_addr;
+reg [15:0] buf_data;
+
+always_ff @(posedge clk_50m) begin
+    active_sync <= { active_sync[0], active };
+    run_sync <= { run_sync[0], run };
+    prev_adc_sync <= adc_sync;
+
+    buf_wr <= 0;
+
+    if (~active_sync[1]) begin
+        started <= 0;
+        triggered <= 0;
+        full <= 0;
+    end else if (~started) begin
+        started <= 1;
+        wptr <= 0;
+        filled <= 0;
+        div_cnt <= 4'd0;
+        sum <= 16'd0;
+    end else begin
+        if (run_sync[1] & ~triggered) begin
+            // An entry written this cycle is the first after the trigger
+            triggered <= 1;
+            pre_count <= pre_keep;
+            start_ptr <= wptr - pre_keep[ENTRIES_WIDTH-1:0];
+        end
+
+        if (~full && adc_sync != prev_adc_sync) begin
+            // adc_sync toggles when a new sample is in adc_sample
+            if (div_cnt == div) begin
+                div_cnt <= 4'd0;
+                sum <= 16'd0;
+
+                buf_wr <= 1;
+                buf_addr <= wptr;
+                buf_data <= sum + adc_sample;
+                wptr <= wptr + 1'd1;
+                if (~filled[ENTRIES_WIDTH]) filled <= filled + 1'd1;
+
+                // Full when the ring wraps round to the first kept entry
+                if (triggered && wptr + 1'd1 == start_ptr) full <= 1;
+            end else begin
+                div_cnt <= div_cnt + 4'd1;
+                sum <= sum + adc_sample;
+            end
+        end
+    end
+end
+
+dualport_ram #(.width(16), .widthad(ENTRIES_WIDTH)) adc_buf
+(
+    .clock_a(clk_50m),
+    .wren_a(buf_wr),
+    .address_a(buf_addr),
+    .data_a(buf_data),
+    .q_a(),
+
+    .clock_b(clk),
+    .wren_b(0),
+    .address_b(address[ENTRIES_WIDTH-1:0] + start_ptr),
+    .data_b(16'd0),
+    .q_b(buf_dout)
+);
+
+endmodule
@@ -0,0 +1,82 @@
+// Audio click
+//
+// Plays a short square wave burst on the audio output, starting at the
+// trigger after being armed, so the click leaves the core on the same frame
+// as the test patch change. The wave flips every 4096 ticks, about 1.2kHz, and
+// the click lasts LENGTH half periods. The tick count at the trigger is kept
+// as the emission timestamp. The output is a signed sample and is silent
+// between clicks.
+//
+// Registers (word offsets)
+//   0 CTRL      write bit 0 to arm or disarm, stops any click playing
+//               read bit 0 ARMED, bit 1 PLAYING
+//   1 LENGTH    half periods per click
+//   2 EMIT      tick count at the start of the last click, high word
+//   3 EMIT      low word
+
+module audio_click(
+    input clk,
+    input reset,
+
+    input trigger,
+    input [31:0] ticks,
+
+    input [1:0] wr,
+
+    input [1:0] address,
+    input [15:0] din,
+    output reg [15:0] dout,
+
+    output reg [15:0] audio
+);
+
+localparam AMPLITUDE = 16'sd12288;
+
+reg armed, playing;
+reg [7:0] length;
+reg [31:0] emit_ticks;
+
+wire [31:0] elapsed = ticks - emit_ticks;
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        armed <= 0;
+        playing <= 0;
+        length <= 8'd24;
+        audio <= 16'd0;
+    end else begin
+        if (armed & trigger) begin
+            armed <= 0;
+            playing <= 1;
+            emit_ticks <= ticks;
+        end
+
+        if (playing) begin
+            if (elapsed[31:12] >= length) begin
+                playing <= 0;
+                audio <= 16'd0;
+            end else begin
+                audio <= elapsed[12] ? -AMPLITUDE : AMPLITUDE;
+            end
+        end
+
+        case (address)
+        0: begin
+            if (wr[0]) begin
+                armed <= din[0];
+                playing <= 0;
+                audio <= 16'd0;
+            end
+            dout <= { 14'd0, playing, armed };
+        end
+        1: begin
+            if (wr[0]) length <= din[7:0];
+            dout <= { 8'd0, length };
+        end
+        2: dout <= emit_ticks[31:16];
+        3: dout <= emit_ticks[15:0];
+        endcase
+    end
+end
+
+endmodule
@@ -0,0 +1,184 @@
+// Sensor waveform capture
+//
+// Once armed, the next trigger pulse starts a capture of the sensor input in
+// the clk_50m domain. Runs of identical samples are stored run-length encoded
+// in a BRAM buffer, one word per run: bit 15 is the level and bits 14:0 the
+// number of samples at that level. Runs longer than 0x7fff samples continue in
+// the next entry with the same level. The capture stops when the buffer is full
+// or the duration has elapsed, at which point the final partial run is also
+// written out.
+//
+// Registers (word offsets, address[12] clear)
+//   0 CTRL      write bit 0 to arm or disarm, clears DONE
+//               read bit 0 ARMED, bit 1 RUNNING, bit 2 DONE
+//   1 DIV       a sample is taken every DIV + 1 clk_50m cycles
+//   2 DURATION  capture length in units of 256 samples
+//   3 COUNT     entries written, valid once DONE
+//   4 TRIGGER   tick count at the trigger, high word
+//   5 TRIGGER   low word
+// With address[12] set, address[11:0] reads an entry from the buffer.
+//
+// DIV and DURATION are used directly by the capture clock domain, only change
+// them while the unit is idle.
+
+module capture(
+    input clk,
+    input reset,
+
+    input clk_50m,
+
+    input sensor,
+    input trigger,
+    input [31:0] ticks,
+
+    input [1:0] wr,
+
+    input [12:0] address,
+    input [15:0] din,
+    output [15:0] dout,
+
+    output reg done
+);
+
+localparam ENTRIES_WIDTH = 12;
+
+reg armed, run;
+reg [15:0] div;
+reg [15:0] duration;
+reg [31:0] trigger_ticks;
+reg [15:0] reg_dout;
+
+reg [1:0] full_sync;
+reg [ENTRIES_WIDTH:0] count;
+
+wire [15:0] buf_dout;
+assign dout = address[12] ? buf_dout : reg_dout;
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        armed <= 0;
+        run <= 0;
+        done <= 0;
+        div <= 16'd49;
+        duration <= 16'd200;
+    end else begin
+        full_sync <= { full_sync[0], full };
+
+        if (armed & trigger) begin
+            armed <= 0;
+            run <= 1;
+            trigger_ticks <= ticks;
+        end
+
+        if (run & full_sync[1]) begin
+            run <= 0;
+            done <= 1;
+            count <= wptr;
+        end
+
+        if (~address[12]) begin
+            case(address[2:0])
+            0: begin
+                if (wr[0]) begin
+                    armed <= din[0];
+                    run <= 0;
+                    done <= 0;
+                end
+                reg_dout <= { 13'd0, done, run, armed };
+            end
+            1: begin
+                if (wr[0]) div[7:0] <= din[7:0];
+                if (wr[1]) div[15:8] <= din[15:8];
+                reg_dout <= div;
+            end
+            2: begin
+                if (wr[0]) duration[7:0] <= din[7:0];
+                if (wr[1]) duration[15:8] <= din[15:8];
+                reg_dout <= duration;
+            end
+            3: reg_dout <= { {(15 - ENTRIES_WIDTH){1'b0}}, count };
+            4: reg_dout <= trigger_ticks[31:16];
+            5: reg_dout <= trigger_ticks[15:0];
+            default: reg_dout <= 16'd0;
+            endcase
+        end
+    end
+end
+
+// clk_50m domain
+reg [2:0] sensor_sync;
+reg [1:0] run_sync;
+reg started, full;
+reg level;
+reg [14:0] run_len;
+reg [15:0] div_cnt;
+reg [23:0] samples;
+reg [ENTRIES_WIDTH:0] wptr;
+
+reg buf_wr;
+reg [ENTRIES_WIDTH-1:0] buf_addr;
+reg [15:0] buf_data;
+
+wire sample = sensor_sync[2];
+
+always_ff @(posedge clk_50m) begin
+    sensor_sync <= { sensor_sync[1:0], sensor };
+    run_sync <= { run_sync[0], run };
+
+    buf_wr <= 0;
+
+    if (~run_sync[1]) begin
+        started <= 0;
+        full <= 0;
+    end else if (~started) begin
+        started <= 1;
+        wptr <= 0;
+        level <= sample;
+        run_len <= 15'd0;
+        div_cnt <= 16'd0;
+        samples <= 24'd0;
+    end else if (~full) begin
+        div_cnt <= div_cnt + 16'd1;
+        if (div_cnt == div) begin
+            div_cnt <= 16'd0;
+            samples <= samples + 24'd1;
+
+            if (samples == { duration, 8'd0 }) begin
+                // Flush the partial run
+                buf_wr <= 1;
+                buf_addr <= wptr[ENTRIES_WIDTH-1:0];
+                buf_data <= { level, run_len };
+                wptr <= wptr + 1'd1;
+                full <= 1;
+            end else if (sample != level || &run_len) begin
+                buf_wr <= 1;
+                buf_addr <= wptr[ENTRIES_WIDTH-1:0];
+                buf_data <= { level, run_len };
+                wptr <= wptr + 1'd1;
+                if (&wptr[ENTRIES_WIDTH-1:0]) full <= 1;
+
+                level <= sample;
+                run_len <= 15'd1;
+            end else begin
+                run_len <= run_len + 15'd1;
+            end
+        end
+    end
+end
+
+dualport_ram #(.width(16), .widthad(ENTRIES_WIDTH)) capture_buf
+(
+    .clock_a(clk_50m),
+    .wren_a(buf_wr),
+    .address_a(buf_addr),
+    .data_a(buf_data),
+    .q_a(),
+
+    .clock_b(clk),
+    .wren_b(0),
+    .address_b(address[ENTRIES_WIDTH-1:0]),
+    .data_b(16'd0),
+    .q_b(buf_dout)
+);
+
+endmodule
@@ -1,3 +1,23 @@
+// Video timing generator
+//
+// The vertical timing registers describe one field. With INTERLACE set the
+// fields alternate: field 1 is one line longer and its vsync starts and ends
+// half a line later, so the display places its lines between those of field
+// 0. Field 0 is the top field. FIELD reads the field being output.
+//
+// VFP is latched at the start of each frame, so it can be changed every frame
+// to vary the frame period without a partial front porch.
+//
+// Registers (word offsets)
+//   0 CE_NUM, 1 CE_DENOM   pixel clock enable ratio
+//   2-5 HACT, HFP, HS, HBP
+//   6-9 VACT, VFP, VS, VBP
+//   10 ARX, 11 ARY         aspect ratio
+//   12-15                  PLL reconfiguration
+//   16 HCNT, 17 VCNT       current position, read only
+//   18 LINE_V, 19 LINE_H   line compare position
+//   20 CTRL                bit 0 INTERLACE, read bit 15 FIELD
+
 module crtc(
     input clk,
     input reset,
@@ -17,6 +37,9 @@ module crtc(
     output vsync,
     output vblank,
     output [11:0] vcnt,
+    output reg field,
+
+    output reg line_irq,
 
     output [11:0] arx,
     output [11:0] ary,
@@ -39,6 +62,7 @@ wire [11:0] hbp = ctrl[5][11:0];
 
 wire [11:0] vact = ctrl[6][11:0];
 wire [11:0] vfp = ctrl[7][11:0];
+reg [11:0] frame_vfp;
 wire [11:0] vs = ctrl[8][11:0];
 wire [11:0] vbp = ctrl[9][11:0];
 
@@ -51,6 +75,11 @@ assign pll_value = {ctrl[12], ctrl[13]};
 localparam PLL_IO_REG = 15;
 localparam HCNT_REG = 16;
 localparam VCNT_REG = 17;
+localparam LINE_V_REG = 18;
+localparam LINE_H_REG = 19;
+localparam CTRL_REG = 20;
+
+wire interlace = ctrl[CTRL_REG][0];
 
 assign hcnt = ctrl[HCNT_REG][11:0];
 assign vcnt = ctrl[VCNT_REG][11:0];
@@ -69,12 +98,21 @@ jtframe_frac_cen ce_pix_frac(
 reg [11:0] hb_start, vb_start;
 reg [11:0] hs_start, vs_start;
 reg [11:0] hs_end, vs_end;
+reg [11:0] h_half;
+
+// Field 1 of an interlaced frame has an extra line and its vsync is offset
+// by half a line
+wire long_field = interlace & field;
+wire vsync_started = vcnt > vs_start || (vcnt == vs_start && hcnt >= h_half);
+wire vsync_ended = vcnt > vs_end || (vcnt == vs_end && hcnt >= h_half);
 
 assign hblank = hcnt >= hb_start || hcnt < hbp;
 assign hsync = hcnt >= hs_start && hcnt < hs_end;
 assign vblank = vcnt >= vb_start || vcnt < vbp;
-assign vsync = vcnt >= vs_start && vcnt < vs_end;
-assign dout = address == PLL_IO_REG ? {16{pll_busy}} : ctrl[address];
+assign vsync = long_field ? (vsync_started & ~vsync_ended) : (vcnt >= vs_start && vcnt < vs_end);
+assign dout = address == PLL_IO_REG ? {16{pll_busy}} :
+              address == CTRL_REG ? { field, ctrl[CTRL_REG][14:0] } :
+              ctrl[address];
 
 wire pll_io_req = wr[0] && address == PLL_IO_REG;
 
@@ -84,6 +122,9 @@ always_ff @(posedge clk) begin
     if (reset) begin
         ctrl[HCNT_REG] <= 16'd0;
         ctrl[VCNT_REG] <= 16'd0;
+        ctrl[CTRL_REG] <= 16'd0;
+        field <= 0;
+        frame_vfp <= 12'd0;
     end
 
     if (wr[0]) ctrl[address][7:0] <= din[7:0];
@@ -96,17 +137,24 @@ always_ff @(posedge clk) begin
     hb_start <= hact + hbp;
     vb_start <= vact + vbp;
     hs_start <= hb_start + hfp;
-    vs_start <= vb_start + vfp;
+    vs_start <= vb_start + frame_vfp;
     hs_end <= hs_start + hs;
     vs_end <= vs_start + vs;
+    h_half <= { 1'b0, hs_end[11:1] };
+
+    // High from the compare position to the end of the line, so the interrupt
+    // controller sees a single rising edge at the exact pixel
+    line_irq <= vcnt == ctrl[LINE_V_REG][11:0] && hcnt >= ctrl[LINE_H_REG][11:0];
 
     if (ce_pixel) begin
         ctrl[HCNT_REG] <= hcnt + 12'd1;
         if (hcnt >= (hs_end - 1)) begin
             ctrl[HCNT_REG] <= 16'd0;
             ctrl[VCNT_REG] <= vcnt + 12'd1;
-            if (vcnt >= (vs_end - 1)) begin
+            if (vcnt >= (vs_end - (long_field ? 12'd0 : 12'd1))) begin
                 ctrl[VCNT_REG] <= 16'd0;
+                field <= interlace & ~field;
+                frame_vfp <= vfp;
             end
         end
     end
@@ -0,0 +1,112 @@
+// Frame timestamps
+//
+// Timestamps the start of the active area, the falling edge of vblank, of N
+// video timing sources. For each source it counts frames, keeps the tick
+// count of the latest edge and tracks the shortest and longest frame period
+// seen since the periods were last cleared. Measuring over many frames gives
+// the true refresh rate of each source and how the sources drift against
+// each other.
+//
+// Reads come from a snapshot so multi-word values are always consistent with
+// each other. Writing SNAPSHOT copies every counter at once.
+//
+// Registers (word offsets)
+//   0 CTRL           write bit 0 to take a snapshot, bit 1 to clear MIN/MAX
+//   8 + 8n           COUNT of source n, high word
+//   9 + 8n           low word
+//   10 + 8n          LAST edge tick count of source n, high word
+//   11 + 8n          low word
+//   12 + 8n          MIN period in ticks of source n, high word
+//   13 + 8n          low word
+//   14 + 8n          MAX period in ticks of source n, high word
+//   15 + 8n          low word
+// MIN reads 0xffffffff and MAX reads 0 until two edges have been seen since
+// they were cleared.
+
+module frame_timer #(
+    parameter N = 2
+) (
+    input clk,
+    input reset,
+
+    input [31:0] ticks,
+    input [N-1:0] vblank,
+
+    input [1:0] wr,
+
+    input [4:0] address,
+    input [15:0] din,
+    output reg [15:0] dout
+);
+
+reg [N-1:0] vb_meta, vb_sync, vb_prev;
+reg [N-1:0] have_last;
+
+reg [31:0] count[N];
+reg [31:0] last[N];
+reg [31:0] min_period[N];
+reg [31:0] max_period[N];
+
+reg [31:0] snap_count[N];
+reg [31:0] snap_last[N];
+reg [31:0] snap_min[N];
+reg [31:0] snap_max[N];
+
+wire snapshot = (address == 5'd0) & wr[0] & din[0];
+wire clear = (address == 5'd0) & wr[0] & din[1];
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        have_last <= { N{1'b0} };
+        for (int i = 0; i < N; i++) begin
+            count[i] <= 32'd0;
+            min_period[i] <= 32'hffffffff;
+            max_period[i] <= 32'd0;
+        end
+    end else begin
+        vb_meta <= vblank;
+        vb_sync <= vb_meta;
+        vb_prev <= vb_sync;
+
+        for (int i = 0; i < N; i++) begin
+            if (clear) begin
+                min_period[i] <= 32'hffffffff;
+                max_period[i] <= 32'd0;
+            end
+
+            if (vb_prev[i] & ~vb_sync[i]) begin
+                count[i] <= count[i] + 32'd1;
+                last[i] <= ticks;
+                have_last[i] <= 1;
+
+                if (have_last[i] & ~clear) begin
+                    if (ticks - last[i] < min_period[i]) min_period[i] <= ticks - last[i];
+                    if (ticks - last[i] > max_period[i]) max_period[i] <= ticks - last[i];
+                end
+            end
+
+            if (snapshot) begin
+                snap_count[i] <= count[i];
+                snap_last[i] <= last[i];
+                snap_min[i] <= min_period[i];
+                snap_max[i] <= max_period[i];
+            end
+        end
+    end
+
+    if (address >= 8 && address < 8 + (8 * N))
+        case (address[2:0])
+        0: dout <= snap_count[(address - 8) >> 3][31:16];
+        1: dout <= snap_count[(address - 8) >> 3][15:0];
+        2: dout <= snap_last[(address - 8) >> 3][31:16];
+        3: dout <= snap_last[(address - 8) >> 3][15:0];
+        4: dout <= snap_min[(address - 8) >> 3][31:16];
+        5: dout <= snap_min[(address - 8) >> 3][15:0];
+        6: dout <= snap_max[(address - 8) >> 3][31:16];
+        7: dout <= snap_max[(address - 8) >> 3][15:0];
+        endcase
+    else
+        dout <= 16'd0;
+end
+
+endmodule
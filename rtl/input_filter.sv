@@ -0,0 +1,94 @@
+// Glitch filter for the user port inputs
+//
+// Runs in the clk_50m domain. An input only changes state once it has held
+// the new level for more than WIDTH clk_50m cycles, so shorter pulses are
+// ignored. The tick count is sampled when the new level first appears and is
+// kept as the edge timestamp, so the timestamp is that of the true first edge
+// and not of the end of the filter delay. A WIDTH of zero passes the input
+// straight through.
+//
+// Registers (word offsets)
+//   0-6        WIDTH for inputs 0-6, in clk_50m cycles
+//   16 + 4n    rising edge timestamp of input n, high word
+//   17 + 4n    low word
+//   18 + 4n    falling edge timestamp of input n, high word
+//   19 + 4n    low word
+//
+// Timestamps are written in the clk_50m domain and should be read after the
+// filtered edge has been seen, by which time they are stable. WIDTH is used
+// directly by the clk_50m domain, only change it while the input is idle.
+
+module input_filter #(
+    parameter N = 7
+) (
+    input clk,
+    input reset,
+
+    input clk_50m,
+    input [31:0] ticks,
+
+    input [N-1:0] in,
+    output reg [N-1:0] out,
+
+    input [1:0] wr,
+
+    input [5:0] address,
+    input [15:0] din,
+    output reg [15:0] dout
+);
+
+reg [15:0] width[N];
+reg [31:0] rise_ticks[N];
+reg [31:0] fall_ticks[N];
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        for (int i = 0; i < N; i++) width[i] <= 16'd0;
+    end else begin
+        if (address < N) begin
+            if (wr[0]) width[address][7:0] <= din[7:0];
+            if (wr[1]) width[address][15:8] <= din[15:8];
+        end
+    end
+
+    if (address < N)
+        dout <= width[address];
+    else if (address >= 16 && address < 16 + (4 * N))
+        case (address[1:0])
+        0: dout <= rise_ticks[(address - 16) >> 2][31:16];
+        1: dout <= rise_ticks[(address - 16) >> 2][15:0];
+        2: dout <= fall_ticks[(address - 16) >> 2][31:16];
+        3: dout <= fall_ticks[(address - 16) >> 2][15:0];
+        endcase
+    else
+        dout <= 16'd0;
+end
+
+reg [N-1:0] in_meta, in_sync;
+reg [15:0] count[N];
+reg [31:0] start_ticks[N];
+
+always_ff @(posedge clk_50m) begin
+    in_meta <= in;
+    in_sync <= in_meta;
+
+    for (int i = 0; i < N; i++) begin
+        if (in_sync[i] == out[i]) begin
+            count[i] <= 16'd0;
+        end else begin
+            if (count[i] == 16'd0) start_ticks[i] <= ticks;
+            count[i] <= count[i] + 16'd1;
+
+            if (count[i] >= width[i]) begin
+                out[i] <= in_sync[i];
+                count[i] <= 16'd0;
+                if (in_sync[i])
+                    rise_ticks[i] <= count[i] == 16'd0 ? ticks : start_ticks[i];
+                else
+                    fall_ticks[i] <= count[i] == 16'd0 ? ticks : start_ticks[i];
+            end
+        end
+    end
+end
+
+endmodule
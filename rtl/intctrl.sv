@@ -0,0 +1,116 @@
+// Interrupt controller
+//
+// Up to 16 level inputs are synchronized and edge detected. An enabled edge
+// sets the source's pending bit, which stays set until the CPU writes a 1 to
+// it. Each of the three CPU interrupt levels (2, 4 and 6) has a mask selecting
+// which pending sources assert it, and the highest asserted level is driven
+// onto the IPL lines until the firmware acknowledges every source routed to it.
+//
+// Registers (word offsets)
+//   0 ENABLE     sources that can become pending
+//   1 PENDING    read pending sources, write 1 to acknowledge
+//   2 EDGE_RISE  rising edges set pending
+//   3 EDGE_FALL  falling edges set pending, set both for either edge
+//   4 LEVEL2     pending sources that raise interrupt level 2
+//   5 LEVEL4     pending sources that raise interrupt level 4
+//   6 LEVEL6     pending sources that raise interrupt level 6
+//   7 STATUS     current synchronized level of each source, read only
+
+module intctrl(
+    input clk,
+    input reset,
+
+    input [1:0] wr,
+
+    input [2:0] address,
+    input [15:0] din,
+    output reg [15:0] dout,
+
+    input [15:0] sources,
+
+    output reg [1:0] irq_level
+);
+
+reg [15:0] enable;
+reg [15:0] pending;
+reg [15:0] edge_rise;
+reg [15:0] edge_fall;
+reg [15:0] level2, level4, level6;
+
+reg [15:0] src_meta, src_sync, src_prev;
+reg [1:0] prev_wr;
+
+function [15:0] word_assign(input [15:0] cur, input [15:0] data, input [1:0] wr);
+    begin
+        word_assign = { wr[1] ? data[15:8] : cur[15:8], wr[0] ? data[7:0] : cur[7:0] };
+    end
+endfunction
+
+// Acknowledge only on the first cycle of a write so an edge arriving while
+// the bus cycle is still in progress is not lost
+wire [1:0] wr_start = wr & ~prev_wr;
+wire [15:0] ack = (address == 3'd1) ? { wr_start[1] ? din[15:8] : 8'd0, wr_start[0] ? din[7:0] : 8'd0 } : 16'd0;
+wire [15:0] triggered = enable & ((src_sync & ~src_prev & edge_rise) | (~src_sync & src_prev & edge_fall));
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        enable <= 16'd0;
+        pending <= 16'd0;
+        edge_rise <= 16'd0;
+        edge_fall <= 16'd0;
+        level2 <= 16'd0;
+        level4 <= 16'd0;
+        level6 <= 16'd0;
+        irq_level <= 2'd0;
+        prev_wr <= 2'b00;
+    end else begin
+        prev_wr <= wr;
+
+        src_meta <= sources;
+        src_sync <= src_meta;
+        src_prev <= src_sync;
+
+        // A new edge wins over an acknowledge in the same cycle
+        pending <= (pending & ~ack) | triggered;
+
+        if (|(pending & level6)) irq_level <= 2'd3;
+        else if (|(pending & level4)) irq_level <= 2'd2;
+        else if (|(pending & level2)) irq_level <= 2'd1;
+        else irq_level <= 2'd0;
+
+        case(address)
+        0: begin
+            enable <= word_assign(enable, din, wr);
+            dout <= enable;
+        end
+        1: begin
+            dout <= pending;
+        end
+        2: begin
+            edge_rise <= word_assign(edge_rise, din, wr);
+            dout <= edge_rise;
+        end
+        3: begin
+            edge_fall <= word_assign(edge_fall, din, wr);
+            dout <= edge_fall;
+        end
+        4: begin
+            level2 <= word_assign(level2, din, wr);
+            dout <= level2;
+        end
+        5: begin
+            level4 <= word_assign(level4, din, wr);
+            dout <= level4;
+        end
+        6: begin
+            level6 <= word_assign(level6, din, wr);
+            dout <= level6;
+        end
+        7: begin
+            dout <= src_sync;
+        end
+        endcase
+    end
+end
+
+endmodule
@@ -12,11 +12,14 @@ module system
 	output  HSync,
 	output  VBlank,
 	output  VSync,
+	output  Field,
 
 	output [7:0] r,
 	output [7:0] g,
 	output [7:0] b,
 
+	output [15:0] audio,
+
 	input [15:0] gamepad,
 	input [6:0] user_in,
 	output reg [6:0] user_out,
@@ -35,6 +38,9 @@ module system
 
 	input         hdmi_vblank,
 
+	input [11:0]  adc_sample, // clk_50m domain
+	input         adc_sync,
+
 	output reg    new_vmode,
 	output [11:0] arx,
 	output [11:0] ary,
@@ -54,8 +60,7 @@ endfunction
 
 
 reg phi1, phi2;
-reg [31:0] ticks, ticks_latch;
-reg [15:0] int_ctrl;
+reg [31:0] ticks, ticks2, ticks_latch;
 
 always_ff @(posedge clk) begin
 	phi1 <= ~phi1;
@@ -71,7 +76,12 @@ wire [2:0] cpu_fc;
 
 wire ram_sel = cpu_addr[23:16] == 8'h10;
 wire ticks_sel = cpu_addr[23:16] == 8'h20;
+wire ticks_latch_sel = ticks_sel & cpu_addr[15:4] == 12'h000;
+wire timer0_sel = ticks_sel & cpu_addr[15:4] == 12'h001;
+wire timer1_sel = ticks_sel & cpu_addr[15:4] == 12'h002;
+wire frame_timer_sel = ticks_sel & cpu_addr[15:6] == 10'h001;
 wire user_sel = cpu_addr[23:16] == 8'h30;
+wire filter_sel = cpu_addr[23:16] == 8'h31;
 wire pad_sel = cpu_addr[23:16] == 8'h40;
 wire hps_sel = cpu_addr[23:16] == 8'h50;
 wire hps_valid_sel = cpu_addr[23:16] == 8'h51;
@@ -80,6 +90,9 @@ wire tilemap_ram_sel = cpu_addr[23:16] == 8'h90;
 wire tilemap_reg_sel = cpu_addr[23:16] == 8'h91;
 wire tilemap_sel = tilemap_ram_sel | tilemap_reg_sel;
 wire blitter_sel = cpu_addr[23:16] == 8'h93;
+wire capture_sel = cpu_addr[23:16] == 8'h94;
+wire adc_sel = cpu_addr[23:16] == 8'h95;
+wire click_sel = cpu_addr[23:16] == 8'h96;
 wire pal_sel = cpu_addr[23:16] == 8'h92;
 wire vio_sel = cpu_addr[23:16] == 8'h60;
 wire int_sel = cpu_addr[23:16] == 8'h70;
@@ -93,13 +106,22 @@ wire [15:0] cpu_din = ram_sel ? ram_dout :
 					  crtc_sel ? crtc_dout :
 					  tilemap_sel ? tilemap_dout :
 					  pal_sel ? pal_dout :
-					  (ticks_sel & a1) ? ticks_latch[15:0] :
-					  (ticks_sel & ~a1) ? ticks_latch[31:16] :
+					  (ticks_latch_sel & a1) ? ticks_latch[15:0] :
+					  (ticks_latch_sel & ~a1) ? ticks_latch[31:16] :
+					  timer0_sel ? timer0_dout :
+					  timer1_sel ? timer1_dout :
+					  frame_timer_sel ? frame_timer_dout :
 					  user_sel ? { 9'd0, user_in[6:0] } :
+					  filter_sel ? filter_dout :
+					  (pad_sel & cpu_addr[2] & a1) ? pad_ticks[15:0] :
+					  (pad_sel & cpu_addr[2] & ~a1) ? pad_ticks[31:16] :
 					  pad_sel ? { 1'd0, gamepad } :
 					  vio_sel ? vio_dout :
-					  int_sel ? int_ctrl :
+					  int_sel ? int_dout :
 					  blitter_sel ? blitter_dout :
+					  capture_sel ? capture_dout :
+					  adc_sel ? adc_dout :
+					  click_sel ? click_dout :
 					  (ver_sel & a1) ? BDI[15:0] :
 					  (ver_sel & ~a1) ? BDI[31:16] : 
 					  rom_dout;
@@ -113,11 +135,19 @@ wire [15:0] tilemap_dout;
 wire [15:0] crtc_dout;
 wire [15:0] pal_dout;
 wire [15:0] blitter_dout;
+wire [15:0] int_dout;
+wire [15:0] timer0_dout, timer1_dout;
+wire [15:0] capture_dout;
+wire [15:0] adc_dout;
+wire [15:0] click_dout;
+wire [15:0] filter_dout;
+wire [15:0] frame_timer_dout;
+wire [6:0] user_filtered;
 
 reg hps_valid = 0;
+reg [31:0] pad_ticks;
 
-reg [1:0] irq_level;
-reg [2:0] irq_flagged;
+wire [1:0] irq_level;
 
 reg cpu_dtack_n;
 reg cpu_vpa_n;
@@ -161,22 +191,23 @@ end
 
 always_ff @(posedge clk) begin
 	reg prev_strobe;
-	reg [31:0] ticks2;
+	reg [31:0] ticks_a, ticks_b;
 
 	if (reset) begin
 		hps_valid <= 0;
 		vio_en <= 0;
 		vio_strobe <= 0;
 		prev_strobe <= 0;
-		int_ctrl <= 16'd0;
 	end else begin
-		ticks2 <= ticks;
-		if (ticks_sel & ~cpu_rw) ticks_latch <= ticks2;
+		// ticks comes from clk_50m, only take it once two samples agree so the
+		// timers never compare against a value caught mid-increment
+		ticks_a <= ticks;
+		ticks_b <= ticks_a;
+		if (ticks_a == ticks_b) ticks2 <= ticks_b;
+		if (ticks_latch_sel & ~cpu_rw) ticks_latch <= ticks2;
 
 		if (user_sel & ~cpu_rw & ~cpu_ds_n[0]) user_out <= cpu_dout[6:0];
 		if (hps_valid_sel & ~cpu_rw & ~cpu_ds_n[0]) hps_valid <= cpu_dout[0];
-		if (int_sel & ~cpu_rw & ~cpu_ds_n[0]) int_ctrl[7:0] <= cpu_dout[7:0];
-		if (int_sel & ~cpu_rw & ~cpu_ds_n[1]) int_ctrl[15:8] <= cpu_dout[15:8];
 
 		prev_strobe <= 0;
 		vio_strobe <= 0;
@@ -193,36 +224,193 @@ always_ff @(posedge clk) begin
 	end
 end
 
-reg [2:0] intp_prev;
+// The gamepad state arrives from the HPS, stamp every change so a press can be
+// timed from when it reached the core
+always_ff @(posedge clk) begin
+	reg [15:0] pad_prev;
+
+	pad_prev <= gamepad;
+	if (gamepad != pad_prev) pad_ticks <= ticks2;
+end
+
+// Interrupt sources, the inverted copies let the start and end of a blanking
+// period be routed to different levels
+wire [15:0] int_sources = {
+	capture_done,   // 15 capture complete
+	timer1_expired, // 14 timer 1
+	line_irq,       // 13 line compare
+	timer0_expired, // 12 timer 0
+	~blit_active,   // 11 blitter done on rising edge
+	user_filtered,  // 4-10 user_in after the glitch filter
+	~hdmi_vblank,   // 3 HDMI active
+	hdmi_vblank,    // 2 HDMI vblank
+	~VBlank,        // 1 active
+	VBlank          // 0 vblank
+};
+
+input_filter #(.N(7)) input_filter(
+	.clk(clk),
+	.reset(reset),
+
+	.clk_50m(clk_50m),
+	.ticks(ticks),
+
+	.in(user_in),
+	.out(user_filtered),
 
-wire intp0_src = int_ctrl[2:0] == 1 ? VBlank : int_ctrl[2:0] == 2 ? hdmi_vblank : int_ctrl[2:0] == 3 ? user_in[1] : 0;
-wire intp1_src = int_ctrl[6:4] == 1 ? VBlank : int_ctrl[6:4] == 2 ? hdmi_vblank : int_ctrl[6:4] == 3 ? user_in[1] : 0;
-wire intp2_src = int_ctrl[10:8] == 1 ? VBlank : int_ctrl[10:8] == 2 ? hdmi_vblank : int_ctrl[10:8] == 3 ? user_in[1] : 0;
+	.wr((filter_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
 
-wire [2:0] intp = { int_ctrl[11] ? ~intp2_src : intp2_src, int_ctrl[7] ? ~intp1_src : intp1_src, int_ctrl[3] ? ~intp0_src : intp0_src };
+	.address(cpu_addr[6:1]),
+	.din(cpu_dout),
+	.dout(filter_dout)
+);
+
+// Palette entry 0x80 is the test patch. The palette has no shadow, so a write
+// shows on the lines still to be drawn straight away. The firmware writes the
+// patch during vblank, so the change is shown from the start of the next
+// active frame, which is reported as the patch commit.
+reg patch_dirty, patch_commit, patch_vblank;
 
 always_ff @(posedge clk) begin
 	if (reset) begin
-		irq_level <= 2'b0;
-		irq_flagged <= 3'b000;
-		intp_prev <= 3'b000;
+		patch_dirty <= 0;
+		patch_commit <= 0;
 	end else begin
-		if (cpu_fc == 3'b111) begin // acknowledge
-			if (irq_level != 2'd0) irq_flagged[irq_level - 1] <= 1'b0;
-			irq_level <= 2'd0;
-		end else if(irq_level == 3'd0) begin
-			if (irq_flagged[2]) irq_level <= 2'd3;
-			else if (irq_flagged[1]) irq_level <= 2'd2;
-			else if (irq_flagged[0]) irq_level <= 2'd1;
-		end
+		patch_commit <= 0;
+		patch_vblank <= VBlank;
 
-		if (intp[0] & ~intp_prev[0]) irq_flagged[0] <= 1'b1;
-		if (intp[1] & ~intp_prev[1]) irq_flagged[1] <= 1'b1;
-		if (intp[2] & ~intp_prev[2]) irq_flagged[2] <= 1'b1;
-		intp_prev <= intp;
+		if (pal_sel & ~cpu_rw & cpu_addr[8:1] == 8'h80) patch_dirty <= 1;
+
+		if (patch_vblank & ~VBlank & patch_dirty) begin
+			patch_dirty <= 0;
+			patch_commit <= 1;
+		end
 	end
 end
 
+wire capture_done;
+
+capture capture(
+	.clk(clk),
+	.reset(reset),
+
+	.clk_50m(clk_50m),
+
+	.sensor(user_in[1]),
+	.trigger(patch_commit),
+	.ticks(ticks2),
+
+	.wr((capture_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[13:1]),
+	.din(cpu_dout),
+	.dout(capture_dout),
+
+	.done(capture_done)
+);
+
+wire adc_done;
+
+adc_capture adc_capture(
+	.clk(clk),
+	.reset(reset),
+
+	.clk_50m(clk_50m),
+
+	.adc_sample(adc_sample),
+	.adc_sync(adc_sync),
+
+	.trigger(patch_commit),
+	.ticks(ticks2),
+
+	.wr((adc_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[13:1]),
+	.din(cpu_dout),
+	.dout(adc_dout),
+
+	.done(adc_done)
+);
+
+// The click starts on the same commit as the test patch
+audio_click audio_click(
+	.clk(clk),
+	.reset(reset),
+
+	.trigger(patch_commit),
+	.ticks(ticks2),
+
+	.wr((click_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[2:1]),
+	.din(cpu_dout),
+	.dout(click_dout),
+
+	.audio(audio)
+);
+
+wire timer0_expired, timer1_expired;
+
+timer timer0(
+	.clk(clk),
+	.reset(reset),
+
+	.ticks(ticks2),
+
+	.wr((timer0_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[2:1]),
+	.din(cpu_dout),
+	.dout(timer0_dout),
+
+	.expired(timer0_expired)
+);
+
+timer timer1(
+	.clk(clk),
+	.reset(reset),
+
+	.ticks(ticks2),
+
+	.wr((timer1_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[2:1]),
+	.din(cpu_dout),
+	.dout(timer1_dout),
+
+	.expired(timer1_expired)
+);
+
+// Source 0 is the core video, source 1 the HDMI output
+frame_timer #(.N(2)) frame_timer(
+	.clk(clk),
+	.reset(reset),
+
+	.ticks(ticks2),
+	.vblank({ hdmi_vblank, VBlank }),
+
+	.wr((frame_timer_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[5:1]),
+	.din(cpu_dout),
+	.dout(frame_timer_dout)
+);
+
+intctrl intctrl(
+	.clk(clk),
+	.reset(reset),
+
+	.wr((int_sel & ~cpu_rw) ? ~cpu_ds_n : 2'b00),
+
+	.address(cpu_addr[3:1]),
+	.din(cpu_dout),
+	.dout(int_dout),
+
+	.sources(int_sources),
+
+	.irq_level(irq_level)
+);
+
 fx68k m68000(
 	.clk(clk),
 	.HALTn(1),
@@ -311,6 +499,7 @@ dualport_unreg_ram #(.width(8), .widthad(8)) pal_ram_1(
 );
 
 wire [11:0] hcnt, vcnt;
+wire line_irq;
 
 crtc crtc(
     .clk(clk),
@@ -331,6 +520,9 @@ crtc crtc(
     .vsync(VSync),
     .vblank(VBlank),
     .vcnt(vcnt),
+    .field(Field),
+
+    .line_irq(line_irq),
 
 	.arx(arx),
 	.ary(ary),
@@ -386,6 +578,8 @@ tilemap tilemap(
 
     .hcnt(hcnt),
     .vcnt(vcnt),
+    .vblank(VBlank),
+    .field(Field),
 
     .color_out(color_idx)
 );
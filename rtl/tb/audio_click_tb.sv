@@ -0,0 +1,219 @@
+// Testbench for the audio click and the audio detector input
+//
+// Arms the click through its registers and triggers it as a patch commit
+// would, then checks the emission stamp, the square wave and the silence
+// after it. A synthetic audio detector drives user input 3 through the input
+// filter, first with a glitch the filter must reject and then with a real
+// edge, and the rising edge stamp is checked against the time the edge was
+// driven. The difference between the two stamps is the audio latency the
+// firmware reports.
+//
+// Run with "make" in this directory, which needs Icarus Verilog.
+
+`timescale 1ns/100ps
+
+module audio_click_tb;
+
+localparam AMPLITUDE = 16'd12288;
+localparam AUDIO_PIN = 3;
+
+// Clocks that never share an edge, like the unrelated system and 50MHz clocks
+reg clk = 0, clk_50m = 0, reset = 1;
+always #10.5 clk = ~clk;
+always #10 clk_50m = ~clk_50m;
+
+// 10MHz tick count from clk_50m, as in system.sv
+reg [31:0] ticks = 32'd0;
+reg [2:0] tick_div = 3'd0;
+always @(posedge clk_50m) begin
+    tick_div <= tick_div == 3'd4 ? 3'd0 : tick_div + 3'd1;
+    if (tick_div == 3'd4) ticks <= ticks + 32'd1;
+end
+
+reg trigger = 0;
+reg [1:0] click_wr = 2'b00;
+reg [1:0] click_addr = 2'd0;
+reg [15:0] click_din = 16'd0;
+wire [15:0] click_dout;
+wire [15:0] audio;
+
+audio_click audio_click(
+    .clk(clk),
+    .reset(reset),
+
+    .trigger(trigger),
+    .ticks(ticks),
+
+    .wr(click_wr),
+
+    .address(click_addr),
+    .din(click_din),
+    .dout(click_dout),
+
+    .audio(audio)
+);
+
+reg [6:0] user_in = 7'd0;
+wire [6:0] user_filtered;
+reg [1:0] filter_wr = 2'b00;
+reg [5:0] filter_addr = 6'd0;
+reg [15:0] filter_din = 16'd0;
+wire [15:0] filter_dout;
+
+input_filter #(.N(7)) input_filter(
+    .clk(clk),
+    .reset(reset),
+
+    .clk_50m(clk_50m),
+    .ticks(ticks),
+
+    .in(user_in),
+    .out(user_filtered),
+
+    .wr(filter_wr),
+
+    .address(filter_addr),
+    .din(filter_din),
+    .dout(filter_dout)
+);
+
+integer errors = 0;
+
+task check(input bit ok, input string what);
+    if (!ok) begin
+        $display("FAIL at %0t: %s", $time, what);
+        errors = errors + 1;
+    end
+endtask
+
+// Register access, dout is registered so reads take an extra cycle
+task click_write(input [1:0] addr, input [15:0] data);
+    @(posedge clk);
+    click_addr <= addr;
+    click_din <= data;
+    click_wr <= 2'b11;
+    @(posedge clk);
+    click_wr <= 2'b00;
+endtask
+
+task click_read(input [1:0] addr, output [15:0] data);
+    @(posedge clk);
+    click_addr <= addr;
+    @(posedge clk);
+    @(posedge clk);
+    data = click_dout;
+endtask
+
+task filter_write(input [5:0] addr, input [15:0] data);
+    @(posedge clk);
+    filter_addr <= addr;
+    filter_din <= data;
+    filter_wr <= 2'b11;
+    @(posedge clk);
+    filter_wr <= 2'b00;
+endtask
+
+task filter_read(input [5:0] addr, output [15:0] data);
+    @(posedge clk);
+    filter_addr <= addr;
+    @(posedge clk);
+    @(posedge clk);
+    data = filter_dout;
+endtask
+
+// One cycle pulse like patch_commit, returns the ticks the click sees with it
+task commit(output [31:0] at_ticks);
+    @(posedge clk);
+    trigger <= 1;
+    @(posedge clk);
+    at_ticks = ticks;
+    trigger <= 0;
+endtask
+
+task wait_ticks(input [31:0] until);
+    wait (ticks == until);
+    repeat (2) @(posedge clk);
+endtask
+
+reg [15:0] data, hi, lo;
+reg [31:0] emit_ticks, edge_ticks, rise_ticks;
+
+initial begin
+    repeat (4) @(posedge clk);
+    reset <= 0;
+    repeat (4) @(posedge clk);
+
+    // A commit without arming stays silent
+    commit(emit_ticks);
+    repeat (8) @(posedge clk);
+    check(audio == 16'd0, "click played without being armed");
+
+    // 1us filter on the detector input, 4 half periods per click
+    filter_write(AUDIO_PIN, 16'd50);
+    click_write(1, 16'd4);
+    click_read(1, data);
+    check(data == 16'd4, "LENGTH did not read back");
+
+    click_write(0, 16'd1);
+    click_read(0, data);
+    check(data[1:0] == 2'b01, "not armed after arming");
+
+    repeat (1000) @(posedge clk);
+    commit(emit_ticks);
+
+    click_read(0, data);
+    check(data[1:0] == 2'b10, "not playing after the commit");
+    click_read(2, hi);
+    click_read(3, lo);
+    check({ hi, lo } == emit_ticks, "EMIT is not the tick count at the commit");
+
+    // First half period high, second low
+    wait_ticks(emit_ticks + 100);
+    check(audio == AMPLITUDE, "first half period is not positive");
+    wait_ticks(emit_ticks + 4096 + 100);
+    check(audio == -AMPLITUDE, "second half period is not negative");
+
+    // A detector glitch shorter than the filter is ignored
+    wait_ticks(emit_ticks + 5000);
+    user_in[AUDIO_PIN] <= 1;
+    #400;
+    user_in[AUDIO_PIN] <= 0;
+    #2000;
+    check(user_filtered[AUDIO_PIN] == 0, "detector glitch passed the filter");
+
+    // The detector hears the click 7000 ticks after the commit
+    wait (ticks == emit_ticks + 7000);
+    edge_ticks = ticks;
+    user_in[AUDIO_PIN] <= 1;
+    #3000;
+    check(user_filtered[AUDIO_PIN] == 1, "detector edge did not pass the filter");
+    filter_read(16 + (4 * AUDIO_PIN), hi);
+    filter_read(17 + (4 * AUDIO_PIN), lo);
+    rise_ticks = { hi, lo };
+    check(rise_ticks - edge_ticks <= 1, "rising edge stamp is not the start of the edge");
+    check(rise_ticks - emit_ticks - 7000 <= 1, "audio latency is not 7000 ticks");
+
+    // Silent once every half period has played
+    wait_ticks(emit_ticks + (4 * 4096) + 100);
+    check(audio == 16'd0, "click did not stop after LENGTH half periods");
+    click_read(0, data);
+    check(data[1:0] == 2'b00, "still playing after LENGTH half periods");
+
+    // Disarming stops a click part way through
+    user_in[AUDIO_PIN] <= 0;
+    click_write(0, 16'd1);
+    commit(emit_ticks);
+    wait_ticks(emit_ticks + 100);
+    check(audio == AMPLITUDE, "second click did not play");
+    click_write(0, 16'd0);
+    repeat (2) @(posedge clk);
+    check(audio == 16'd0, "disarming did not stop the click");
+
+    if (errors == 0)
+        $display("PASS");
+    else
+        $display("FAILED with %0d errors", errors);
+    $finish;
+end
+
+endmodule
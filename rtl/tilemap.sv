@@ -1,3 +1,24 @@
+// Tilemap
+//
+// Registers (word offsets)
+//   0 HOFS, 1 VOFS       scroll offsets
+//   2 REGION_VSTART      lines in [REGION_VSTART, REGION_VEND) use the
+//   3 REGION_VEND        region scroll offsets instead
+//   4 REGION_HOFS, 5 REGION_VOFS
+//   6 NEXT_HOFS, 7 NEXT_VOFS
+//   8 FLIP               write a tag to copy NEXT_HOFS/NEXT_VOFS to the scroll
+//                        offsets at the start of vblank, read bit 15 PENDING
+//                        and bits 7:0 the tag of the front page
+//   16 CTRL              bit 0 DOUBLE_H, shows every tile pixel as 2 output
+//                        pixels, bit 1 DOUBLE_V as 2 output lines
+//   17 FIELD_HOFS        added to HOFS during field 1 of an interlaced frame
+//
+// With DOUBLE_H and DOUBLE_V set the scroll offsets and region lines are in
+// tile pixels, so the same VRAM layout fills a raster twice the size. The pixel
+// clock enable must be at most every other clk with DOUBLE_H so the tile
+// lookup keeps up. FIELD_HOFS lets each field of an interlaced frame show its
+// own page, drawn beside the other in VRAM.
+
 module tilemap(
     input clk,
     input reset,
@@ -15,6 +36,8 @@ module tilemap(
 
     input [11:0] hcnt,
     input [11:0] vcnt,
+    input vblank,
+    input field,
 
     output reg [7:0] color_out
 );
@@ -22,14 +45,63 @@ module tilemap(
 reg [15:0] hofs;
 reg [15:0] vofs;
 
-wire [11:0] H = hcnt + hofs[11:0];
-wire [11:0] V = vcnt + vofs[11:0];
+// Lines in [region_vstart, region_vend) use their own scroll offsets
+reg [15:0] region_vstart;
+reg [15:0] region_vend;
+reg [15:0] region_hofs;
+reg [15:0] region_vofs;
+
+// Flip queue, committed to hofs/vofs at the start of vblank
+reg [15:0] next_hofs;
+reg [15:0] next_vofs;
+reg [7:0] next_tag;
+reg [7:0] front_tag;
+reg flip_pending;
+reg vblank_prev;
+
+reg double_h, double_v;
+reg [15:0] field_hofs;
+
+// Tile pixel position before scrolling
+wire [11:0] hpos = double_h ? { 1'b0, hcnt[11:1] } : hcnt;
+wire [11:0] vpos = double_v ? { 1'b0, vcnt[11:1] } : vcnt;
+
+// Each tile pixel is output on the even then the odd hcnt when doubled
+wire pixel_adv = ce_pixel & (~double_h | ~hcnt[0]);
+
+wire in_region = vpos >= region_vstart[11:0] && vpos < region_vend[11:0];
+
+wire [11:0] page_hofs = field ? hofs[11:0] + field_hofs[11:0] : hofs[11:0];
+wire [11:0] H = hpos + (in_region ? region_hofs[11:0] : page_hofs);
+wire [11:0] V = vpos + (in_region ? region_vofs[11:0] : vofs[11:0]);
 
 wire [15:0] tileref_q;
 
 wire [15:0] ram_dout;
 
-assign dout = (cs_reg & ~address[0]) ? hofs : (cs_reg & address[0]) ? vofs : ram_dout;
+reg [15:0] reg_dout;
+always_comb begin
+    case(address[2:0])
+    3'd0: reg_dout = hofs;
+    3'd1: reg_dout = vofs;
+    3'd2: reg_dout = region_vstart;
+    3'd3: reg_dout = region_vend;
+    3'd4: reg_dout = region_hofs;
+    3'd5: reg_dout = region_vofs;
+    3'd6: reg_dout = next_hofs;
+    3'd7: reg_dout = next_vofs;
+    endcase
+    if (address[3]) reg_dout = { flip_pending, 7'd0, front_tag };
+    if (address[4]) reg_dout = address[0] ? field_hofs : { 14'd0, double_v, double_h };
+end
+
+assign dout = cs_reg ? reg_dout : ram_dout;
+
+function [15:0] word_assign(input [15:0] cur, input [15:0] data, input [1:0] wr);
+    begin
+        word_assign = { wr[1] ? data[15:8] : cur[15:8], wr[0] ? data[7:0] : cur[7:0] };
+    end
+endfunction
 
 dualport_ram #(.width(8), .widthad(14)) ram_0
 (
@@ -78,12 +150,45 @@ reg [2:0] stage;
 
 always_ff @(posedge clk) begin
 
-    if (cs_reg & wr[0] & ~address[0]) hofs[7:0] <= din[7:0];
-    if (cs_reg & wr[1] & ~address[0]) hofs[15:8] <= din[15:8];
-    if (cs_reg & wr[0] &  address[0]) vofs[7:0] <= din[7:0];
-    if (cs_reg & wr[1] &  address[0]) vofs[15:8] <= din[15:8];
+    vblank_prev <= vblank;
+
+    if (reset) begin
+        region_vstart <= 16'd0;
+        region_vend <= 16'd0;
+        flip_pending <= 0;
+        front_tag <= 8'd0;
+        double_h <= 0;
+        double_v <= 0;
+        field_hofs <= 16'd0;
+    end else if (vblank & ~vblank_prev & flip_pending) begin
+        hofs <= next_hofs;
+        vofs <= next_vofs;
+        front_tag <= next_tag;
+        flip_pending <= 0;
+    end else if (cs_reg & |wr & address[4]) begin
+        if (address[0]) begin
+            field_hofs <= word_assign(field_hofs, din, wr);
+        end else if (wr[0]) begin
+            double_h <= din[0];
+            double_v <= din[1];
+        end
+    end else if (cs_reg & |wr & address[3]) begin
+        next_tag <= din[7:0];
+        flip_pending <= 1;
+    end else if (cs_reg & |wr) begin
+        case(address[2:0])
+        3'd0: hofs <= word_assign(hofs, din, wr);
+        3'd1: vofs <= word_assign(vofs, din, wr);
+        3'd2: region_vstart <= word_assign(region_vstart, din, wr);
+        3'd3: region_vend <= word_assign(region_vend, din, wr);
+        3'd4: region_hofs <= word_assign(region_hofs, din, wr);
+        3'd5: region_vofs <= word_assign(region_vofs, din, wr);
+        3'd6: next_hofs <= word_assign(next_hofs, din, wr);
+        3'd7: next_vofs <= word_assign(next_vofs, din, wr);
+        endcase
+    end
 
-    if (ce_pixel) begin
+    if (pixel_adv) begin
         stage <= stage + 3'd1;
 
         vcnt_prev <= vcnt;
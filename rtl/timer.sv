@@ -0,0 +1,68 @@
+// Compare timer
+//
+// Fires when the free running tick counter reaches an absolute compare value.
+// The comparison is signed on the difference, so a compare value set up to 2^31
+// ticks in the past fires immediately and the counter wrapping is harmless.
+//
+// Registers (word offsets)
+//   0 COMPARE high word
+//   1 COMPARE low word
+//   2 CTRL  write bit 0 to arm or disarm, clears EXPIRED
+//           read bit 0 ARMED, bit 1 EXPIRED
+
+module timer(
+    input clk,
+    input reset,
+
+    input [31:0] ticks,
+
+    input [1:0] wr,
+
+    input [1:0] address,
+    input [15:0] din,
+    output reg [15:0] dout,
+
+    output reg expired
+);
+
+reg [31:0] compare;
+reg armed;
+
+wire [31:0] delta = ticks - compare;
+
+always_ff @(posedge clk) begin
+    if (reset) begin
+        armed <= 0;
+        expired <= 0;
+    end else begin
+        if (armed & ~delta[31]) begin
+            armed <= 0;
+            expired <= 1;
+        end
+
+        case(address)
+        0: begin
+            if (wr[0]) compare[23:16] <= din[7:0];
+            if (wr[1]) compare[31:24] <= din[15:8];
+            dout <= compare[31:16];
+        end
+        1: begin
+            if (wr[0]) compare[7:0] <= din[7:0];
+            if (wr[1]) compare[15:8] <= din[15:8];
+            dout <= compare[15:0];
+        end
+        2: begin
+            if (wr[0]) begin
+                armed <= din[0];
+                expired <= 0;
+            end
+            dout <= { 14'd0, expired, armed };
+        end
+        default: begin
+            dout <= 16'd0;
+        end
+        endcase
+    end
+end
+
+endmodule